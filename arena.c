@@ -0,0 +1,49 @@
+
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN (sizeof(max_align_t))
+
+struct arena_chunk {
+  struct arena_chunk* next_chunk;
+  max_align_t data[]; // aligned start of the usable space
+};
+
+
+void* arena_alloc(struct arena* arena, size_t size) {
+  size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+  if (size > arena->remaining) {
+    // start a new chunk; oversized requests get a chunk of their own
+    size_t chunk_size = (size > ARENA_CHUNK_SIZE) ? size : ARENA_CHUNK_SIZE;
+    struct arena_chunk* chunk = malloc(sizeof(struct arena_chunk) + chunk_size);
+    if (NULL == chunk) {
+      perror("ERROR allocating arena chunk");
+      exit(EXIT_FAILURE);
+    }
+    chunk->next_chunk = arena->chunks;
+    arena->chunks = chunk;
+    arena->next = (char*)chunk->data;
+    arena->remaining = chunk_size;
+  }
+
+  void* ptr = arena->next;
+  arena->next += size;
+  arena->remaining -= size;
+  return ptr;
+}
+
+
+void arena_release(struct arena* arena) {
+  struct arena_chunk* chunk = arena->chunks;
+  while (NULL != chunk) {
+    struct arena_chunk* next_chunk = chunk->next_chunk;
+    free(chunk);
+    chunk = next_chunk;
+  }
+  arena->chunks = NULL;
+  arena->next = NULL;
+  arena->remaining = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/* A bump allocator for objects that all live until the end of a simulation
+ * (processes, bursts).  Individual objects are never freed; arena_release()
+ * returns every chunk to libc at once. */
+
+struct arena_chunk;
+
+struct arena {
+  struct arena_chunk* chunks; // most recently allocated chunk first
+  char* next;                 // next free byte in the current chunk
+  size_t remaining;           // bytes left in the current chunk
+};
+
+#define ARENA_INIT {NULL, NULL, 0}
+
+void* arena_alloc(struct arena* arena, size_t size);
+void arena_release(struct arena* arena);
+
+#endif /* _ARENA_H_ */
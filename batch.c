@@ -0,0 +1,335 @@
+
+#include "simulation.h"
+#include "policy.h"
+#include "options.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+/* Runs many simulations at once on a pool of threads.  Each job is one
+ * policy over one trace; its output is captured in memory and compared with
+ * an expected output file when the job has one.  Every simulation owns all
+ * of its state, so jobs share nothing but the read-only policy table.
+ */
+
+typedef enum { JOB_PASS, JOB_FAIL, JOB_RAN, JOB_ERROR } job_result_t;
+
+static const char* job_result_strings[] = {"PASS", "FAIL", "RAN", "ERROR"};
+
+struct job {
+  const struct sched_policy* policy;
+  char* trace;    // path of the .proc file
+  char* expected; // path of the expected output, or NULL
+  job_result_t result;
+  double seconds; // wall time of load + run
+};
+
+struct batch {
+  struct job* jobs;
+  size_t num_jobs;
+  size_t capacity;
+  struct sim_options options;
+
+  pthread_mutex_t lock; // guards next_job
+  size_t next_job;
+};
+
+
+static double now_seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+static void add_job(struct batch* batch, const struct sched_policy* policy, const char* trace,
+                    const char* expected) {
+  if (batch->num_jobs == batch->capacity) {
+    batch->capacity = (0 == batch->capacity) ? 64 : batch->capacity * 2;
+    batch->jobs = realloc(batch->jobs, batch->capacity * sizeof(struct job));
+    assert(NULL != batch->jobs);
+  }
+  struct job* job = &batch->jobs[batch->num_jobs++];
+  job->policy = policy;
+  job->trace = strdup(trace);
+  job->expected = (NULL == expected) ? NULL : strdup(expected);
+  job->result = JOB_ERROR;
+  job->seconds = 0.0;
+}
+
+
+/* reads a jobs file: one "policy trace [expected]" job per line, where a
+ * relative trace or expected path is taken relative to the jobs file and
+ * '#' starts a comment
+ *
+ * returns 0 on success or -1 after printing what went wrong
+ */
+static int read_jobs(struct batch* batch, const char* filename) {
+  FILE* in = fopen(filename, "r");
+  if (NULL == in) {
+    perror("ERROR opening jobs file");
+    return -1;
+  }
+  const char* slash = strrchr(filename, '/');
+  int dir_len = (NULL == slash) ? 0 : (int)(slash - filename + 1);
+
+  char* line = NULL;
+  size_t line_size = 0;
+  unsigned int line_number = 0;
+  int result = 0;
+  while (0 == result && -1 != getline(&line, &line_size, in)) {
+    ++line_number;
+    char* comment = strchr(line, '#');
+    if (NULL != comment)
+      *comment = '\0';
+
+    char* save = NULL;
+    char* fields[4] = {NULL, NULL, NULL, NULL};
+    int num_fields = 0;
+    for (char* field = strtok_r(line, " \t\r\n", &save); NULL != field && num_fields < 4;
+         field = strtok_r(NULL, " \t\r\n", &save)) {
+      fields[num_fields++] = field;
+    }
+    if (0 == num_fields)
+      continue;
+    if (num_fields < 2 || num_fields > 3) {
+      fprintf(stderr, "%s:%u: expected \"policy trace [expected]\"\n", filename, line_number);
+      result = -1;
+      break;
+    }
+
+    const struct sched_policy* policy = find_policy(fields[0]);
+    if (NULL == policy) {
+      result = -1;
+      break;
+    }
+    char paths[2][4096];
+    for (int i = 1; i < num_fields; ++i) {
+      if ('/' == fields[i][0])
+        snprintf(paths[i - 1], sizeof(paths[i - 1]), "%s", fields[i]);
+      else
+        snprintf(paths[i - 1], sizeof(paths[i - 1]), "%.*s%s", dir_len, filename, fields[i]);
+    }
+    add_job(batch, policy, paths[0], (3 == num_fields) ? paths[1] : NULL);
+  }
+
+  free(line);
+  fclose(in);
+  return result;
+}
+
+
+// returns nonzero if the file at path holds exactly size bytes equal to data
+static int file_matches(const char* path, const char* data, size_t size) {
+  FILE* in = fopen(path, "rb");
+  if (NULL == in)
+    return 0;
+  char chunk[8192];
+  size_t offset = 0;
+  size_t got;
+  int matches = 1;
+  while (matches && 0 != (got = fread(chunk, 1, sizeof(chunk), in))) {
+    matches = got <= size - offset && 0 == memcmp(chunk, data + offset, got);
+    offset += got;
+  }
+  fclose(in);
+  return matches && offset == size;
+}
+
+
+static void run_job(struct job* job, const struct sim_options* options) {
+  double start = now_seconds();
+  char* output = NULL;
+  size_t output_size = 0;
+  FILE* out = open_memstream(&output, &output_size);
+  assert(NULL != out);
+
+  sim_t* sim = sim_create();
+  job->result = JOB_ERROR;
+  if (0 == sim_load(sim, job->trace, FALSE)) {
+    int status = sim_run(sim, job->policy, options, out);
+    fflush(out);
+    if (0 != status)
+      job->result = JOB_ERROR;
+    else if (NULL == job->expected)
+      job->result = JOB_RAN;
+    else
+      job->result = file_matches(job->expected, output, output_size) ? JOB_PASS : JOB_FAIL;
+  }
+  sim_destroy(sim);
+  fclose(out);
+  free(output);
+  job->seconds = now_seconds() - start;
+}
+
+
+static void* worker(void* arg) {
+  struct batch* batch = arg;
+  for (;;) {
+    pthread_mutex_lock(&batch->lock);
+    size_t next = batch->next_job++;
+    pthread_mutex_unlock(&batch->lock);
+    if (next >= batch->num_jobs)
+      return NULL;
+    run_job(&batch->jobs[next], &batch->options);
+  }
+}
+
+
+static void usage(const char* program) {
+  fprintf(stderr, "Usage: %s [options] [trace.proc...]\n"
+          "  --jobs FILE        run the jobs listed in FILE, one \"policy trace [expected]\"\n"
+          "                     per line; paths are relative to FILE and '#' starts a comment\n"
+          "  --policy P[,P...]  run every trace given on the command line under each policy\n"
+          "  -j N               run N simulations at a time (default: one per online cpu)\n"
+          SIM_OPTIONS_USAGE
+          "Prints PASS or FAIL for jobs with an expected output, RAN for the others,\n"
+          "and ERROR for jobs that could not load or write; exits nonzero unless every\n"
+          "job passed or ran.  Built-in policies: ",
+          program);
+  print_policies(stderr);
+}
+
+
+int main(int argc, char** argv) {
+  static const struct option long_options[] = {
+    {"jobs", required_argument, NULL, 'J'},
+    {"policy", required_argument, NULL, 'p'},
+    {"cpus", required_argument, NULL, 'c'},
+    {"migration-cost", required_argument, NULL, 'm'},
+    {"switch-cost", required_argument, NULL, 'X'},
+    {"decision-cost", required_argument, NULL, 'D'},
+    {"no-steal", no_argument, NULL, 'S'},
+    {"seed", required_argument, NULL, 's'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+  struct batch batch;
+  memset(&batch, 0, sizeof(batch));
+  batch.options = (struct sim_options){.num_cpus = 1, .work_stealing = TRUE};
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned long num_threads = (online > 0) ? (unsigned long)online : 1;
+  const char* jobs_file = NULL;
+  const char* policy_names = NULL;
+
+  int opt;
+  unsigned long value;
+  while (-1 != (opt = getopt_long(argc, argv, "j:p:h", long_options, NULL))) {
+    switch (opt) {
+    case 'J':
+      jobs_file = optarg;
+      break;
+    case 'p':
+      policy_names = optarg;
+      break;
+    case 'j':
+      if (parse_count(optarg, "number of threads", 1, 4096, &num_threads))
+        return EXIT_FAILURE;
+      break;
+    case 'c':
+      if (parse_count(optarg, "number of cpus", 1, 65536, &value))
+        return EXIT_FAILURE;
+      batch.options.num_cpus = value;
+      break;
+    case 'm':
+      if (parse_count(optarg, "migration cost", 0, SIM_MAX_SWITCH_CHARGE, &value))
+        return EXIT_FAILURE;
+      batch.options.migration_cost = value;
+      break;
+    case 'X':
+      if (parse_count(optarg, "switch cost", 0, SIM_MAX_SWITCH_CHARGE, &value))
+        return EXIT_FAILURE;
+      batch.options.switch_cost = value;
+      break;
+    case 'D':
+      if (parse_count(optarg, "decision cost", 0, SIM_MAX_SWITCH_CHARGE, &value))
+        return EXIT_FAILURE;
+      batch.options.decision_cost = value;
+      break;
+    case 'S':
+      batch.options.work_stealing = FALSE;
+      break;
+    case 's':
+      if (parse_count(optarg, "seed", 0, ULONG_MAX, &batch.options.seed))
+        return EXIT_FAILURE;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if ((NULL == jobs_file && optind >= argc) || (optind < argc && NULL == policy_names)) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // every policy is looked up here, before any thread starts
+  int status = EXIT_SUCCESS;
+  if (NULL != jobs_file && 0 != read_jobs(&batch, jobs_file))
+    status = EXIT_FAILURE;
+  if (EXIT_SUCCESS == status && optind < argc) {
+    const struct sched_policy** policies = NULL;
+    int num_policies = find_policies(policy_names, &policies);
+    if (num_policies < 0)
+      status = EXIT_FAILURE;
+    for (int i = 0; i < num_policies; ++i) {
+      for (int arg = optind; arg < argc; ++arg) {
+        add_job(&batch, policies[i], argv[arg], NULL);
+      }
+    }
+    free(policies);
+  }
+
+  if (EXIT_SUCCESS == status) {
+    if (num_threads > batch.num_jobs)
+      num_threads = (batch.num_jobs > 0) ? batch.num_jobs : 1;
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    assert(NULL != threads);
+
+    double start = now_seconds();
+    for (unsigned long i = 0; i < num_threads; ++i) {
+      int err = pthread_create(&threads[i], NULL, worker, &batch);
+      assert(0 == err);
+      (void)err;
+    }
+    for (unsigned long i = 0; i < num_threads; ++i) {
+      pthread_join(threads[i], NULL);
+    }
+    double wall = now_seconds() - start;
+    free(threads);
+    pthread_mutex_destroy(&batch.lock);
+
+    unsigned int counts[4] = {0, 0, 0, 0};
+    double busy = 0.0;
+    for (size_t i = 0; i < batch.num_jobs; ++i) {
+      const struct job* job = &batch.jobs[i];
+      printf("%-5s %-8s %s %.3f ms\n", job_result_strings[job->result], job->policy->name, job->trace,
+             job->seconds * 1e3);
+      ++counts[job->result];
+      busy += job->seconds;
+    }
+    printf("%zu jobs: %u passed, %u failed, %u ran, %u errors in %.3f ms on %lu threads (%.3f ms of simulation)\n",
+           batch.num_jobs, counts[JOB_PASS], counts[JOB_FAIL], counts[JOB_RAN], counts[JOB_ERROR],
+           wall * 1e3, num_threads, busy * 1e3);
+    if (counts[JOB_FAIL] > 0 || counts[JOB_ERROR] > 0)
+      status = EXIT_FAILURE;
+  }
+
+  for (size_t i = 0; i < batch.num_jobs; ++i) {
+    free(batch.jobs[i].trace);
+    free(batch.jobs[i].expected);
+  }
+  free(batch.jobs);
+  unload_policies();
+  return status;
+}
@@ -3,15 +3,18 @@
 
 #include "process.h"
 
-typedef enum {ARRIVAL, FINISH_CPU, FINISH_IO, FINISH_TIME_SLICE} event_type_t;
+typedef enum {ARRIVAL, FINISH_CPU, FINISH_IO, FINISH_TIME_SLICE, TIMER, NUM_EVENT_TYPES} event_type_t;
 
 struct evt {
   time_ticks_t time;
   event_type_t type;
-  struct process* proc;
+  struct process* proc; // NULL for a TIMER event
+  unsigned long seq; // insertion order; breaks ties between events at the same time
+  int cancelled; // nonzero once cancel_event() has been called; skipped when popped
 };
 
 void print_event(const struct evt* event);
+const char* event_type_string(event_type_t type);
 
 #endif /* _EVENT_H_ */
 
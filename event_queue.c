@@ -1,112 +1,255 @@
+
 #include "event_queue.h"
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-static const char* event_type_strings[] = {"ARRIVAL", "FINISH CPU", "FINISH I/O", "FINISH TIME SLICE"};
+static const char* event_type_strings[] = {"ARRIVAL", "FINISH CPU", "FINISH I/O", "FINISH TIME SLICE", "TIMER"};
+
+// a pooled event is either live or a link in the free list
+union evt_slot {
+  struct evt event;
+  union evt_slot* next_free;
+};
+
+struct evt_slab {
+  struct evt_slab* next_slab;
+  union evt_slot slots[EVENT_SLAB_SIZE];
+};
+
+
+static struct evt* alloc_event(struct event_queue* queue) {
+  if (NULL == queue->free_slots) {
+    struct evt_slab* slab = malloc(sizeof(struct evt_slab));
+    assert(NULL != slab);
+    slab->next_slab = queue->slabs;
+    queue->slabs = slab;
+    // thread the new slots onto the free list
+    for (unsigned int i = 0; i < EVENT_SLAB_SIZE; ++i) {
+      slab->slots[i].next_free = queue->free_slots;
+      queue->free_slots = &slab->slots[i];
+    }
+  }
+  union evt_slot* slot = queue->free_slots;
+  queue->free_slots = slot->next_free;
+  return &slot->event;
+}
 
-static struct evt_node* event_queue = NULL;
+
+void free_event(struct event_queue* queue, const struct evt* event) {
+  union evt_slot* slot = (union evt_slot*)event;
+  slot->next_free = queue->free_slots;
+  queue->free_slots = slot;
+}
 
 
-const struct evt* pop_next_event() {
-  if (NULL == event_queue)
-    return NULL;
+// returns nonzero if event a must be handled before event b
+static int event_before(const struct evt* a, const struct evt* b) {
+  if (a->time != b->time)
+    return a->time < b->time;
+  return a->seq < b->seq;
+}
 
-  const struct evt* event = event_queue->event;
-  const struct evt_node* old_node = event_queue;
-  event_queue = event_queue->next_event;
-  free((void*)old_node); // free the queue node; caller is responsible for freeing the event itself
+
+static void sift_up(struct event_queue* queue, size_t i) {
+  const struct evt* event = queue->heap[i];
+  while (i > 0) {
+    size_t parent = (i - 1) / EVENT_HEAP_ARITY;
+    if (!event_before(event, queue->heap[parent]))
+      break;
+    queue->heap[i] = queue->heap[parent];
+    i = parent;
+    SIM_STAT(++queue->stats.sift_up_levels);
+  }
+  queue->heap[i] = event;
+}
+
+
+static void sift_down(struct event_queue* queue, size_t i) {
+  const struct evt* event = queue->heap[i];
+  for (;;) {
+    size_t first_child = i * EVENT_HEAP_ARITY + 1;
+    if (first_child >= queue->size)
+      break;
+    size_t last_child = first_child + EVENT_HEAP_ARITY;
+    if (last_child > queue->size)
+      last_child = queue->size;
+
+    SIM_STAT(queue->stats.children_scanned += last_child - first_child);
+    size_t min_child = first_child;
+    for (size_t child = first_child + 1; child < last_child; ++child) {
+      if (event_before(queue->heap[child], queue->heap[min_child]))
+        min_child = child;
+    }
+    if (!event_before(queue->heap[min_child], event))
+      break;
+    queue->heap[i] = queue->heap[min_child];
+    i = min_child;
+    SIM_STAT(++queue->stats.sift_down_levels);
+  }
+  queue->heap[i] = event;
+}
+
+
+// removes the event at heap index i and restores the heap property
+static const struct evt* remove_at(struct event_queue* queue, size_t i) {
+  assert(i < queue->size);
+  const struct evt* event = queue->heap[i];
+  --queue->size;
+  SIM_STAT(++queue->stats.removals);
+  if (i < queue->size) {
+    queue->heap[i] = queue->heap[queue->size];
+    if (i > 0 && event_before(queue->heap[i], queue->heap[(i - 1) / EVENT_HEAP_ARITY]))
+      sift_up(queue, i);
+    else
+      sift_down(queue, i);
+  }
   return event;
 }
 
 
-void new_event(time_ticks_t time, event_type_t type, struct process* proc) {
-  // Find where to insert the event
-  struct evt_node* prev = NULL;
-  struct evt_node* next = event_queue;
+const struct evt* pop_next_event(struct event_queue* queue) {
+  while (queue->size > 0) {
+    const struct evt* event = remove_at(queue, 0);
+    if (!event->cancelled)
+      return event; // caller is responsible for freeing the event
+    SIM_STAT(++queue->stats.tombstones);
+    free_event(queue, event);
+  }
+  return NULL;
+}
+
 
-  // TODO: check for duplicate events while doing this
-  while (NULL != next && time >= next->event->time) {
-    prev = next;
-    next = next->next_event;
+const struct evt* peek_next_event(struct event_queue* queue) {
+  // discard cancelled events now; they would be skipped when popped anyway
+  while (queue->size > 0 && queue->heap[0]->cancelled) {
+    SIM_STAT(++queue->stats.tombstones);
+    free_event(queue, remove_at(queue, 0));
   }
-  // INVARIANT: at the end of the list (next == NULL)
-  //   OR prev.time <= event.time < next.time
-  // (both NULL means event_queue was empty)
+  return (queue->size > 0) ? queue->heap[0] : NULL;
+}
 
-  // Create the event struct and event queue node, initialize both
-  struct evt* event = malloc(sizeof(struct evt));
+
+struct evt* new_event(struct event_queue* queue, time_ticks_t time, event_type_t type, struct process* proc) {
+  // Create the event struct, initialize it
+  struct evt* event = alloc_event(queue);
   memset(event, 0, sizeof(struct evt));
   event->time = time;
   event->type = type;
   event->proc = proc;
+  event->seq = queue->next_seq++;
 
 #ifdef DEBUG
   fprintf(stderr, "Creating Event: ");
   print_event(event);
 #endif // DEBUG
 
-  struct evt_node* event_node = malloc(sizeof(struct evt_node));
-  memset(event_node, 0, sizeof(struct evt_node));
-  event_node->event = event;
-  event_node->next_event = next;
-
-  // Do the actual insert
-  if (NULL == prev)
-    event_queue = event_node; // evt is first! (also handles empty queue)
-  else
-    prev->next_event = event_node; // evt is not first
+  if (queue->size == queue->capacity) {
+    queue->capacity = (0 == queue->capacity) ? 64 : queue->capacity * 2;
+    queue->heap = realloc(queue->heap, queue->capacity * sizeof(const struct evt*));
+    assert(NULL != queue->heap);
+  }
+  queue->heap[queue->size] = event;
+  sift_up(queue, queue->size++);
+  SIM_STAT(++queue->stats.inserts);
+  SIM_STAT(if (queue->size > queue->stats.peak_size) queue->stats.peak_size = queue->size);
+  return event;
 }
 
 
-void remove_events(pid_t pid) {
-  struct evt_node* prev_node = NULL;
-  struct evt_node* event_node = event_queue;
-  while (NULL != event_node) {
-    if (pid == event_node->event->proc->pid) {
+void cancel_event(struct evt* event) {
+  assert(!event->cancelled);
 
 #ifdef DEBUG
-      fprintf(stderr, "Removing Event: ");
-      print_event(event_node->event);
+  fprintf(stderr, "Cancelling Event: ");
+  print_event(event);
 #endif // DEBUG
 
-      if (NULL == prev_node) {
-        assert(event_queue == event_node);
-        event_queue = event_node->next_event;
-        free((void*)event_node->event); // free the event
-        free((void*)event_node); // free the queue node
-        event_node = event_queue;
-      } else {
-        assert(prev_node->next_event == event_node);
-        prev_node->next_event = event_node->next_event;
-        free((void*)event_node->event); // free the event
-        free((void*)event_node); // free the queue node
-        event_node = prev_node->next_event;
-      }
-
-    } else {
-      prev_node = event_node;
-      event_node = event_node->next_event;
-    }
+  event->cancelled = 1;
+}
+
+
+void cleanup_event_queue(struct event_queue* queue) {
+  // any events still queued live in the slabs, so this frees them too
+  while (NULL != queue->slabs) {
+    struct evt_slab* next_slab = queue->slabs->next_slab;
+    free(queue->slabs);
+    queue->slabs = next_slab;
   }
+  queue->free_slots = NULL;
+  free(queue->heap);
+  queue->heap = NULL;
+  queue->size = queue->capacity = 0;
+  queue->next_seq = 0;
+}
+
+
+void copy_event_queue(const struct event_queue* queue, struct evt* events) {
+  for (size_t i = 0; i < queue->size; ++i) {
+    events[i] = *queue->heap[i];
+  }
+}
+
+
+void restore_event_queue(struct event_queue* queue, const struct evt* events, size_t n,
+                         unsigned long next_seq, struct evt** restored) {
+  // recycle the current events; the slabs stay allocated for the new ones
+  for (size_t i = 0; i < queue->size; ++i) {
+    free_event(queue, queue->heap[i]);
+  }
+  if (n > queue->capacity) {
+    queue->capacity = n;
+    queue->heap = realloc(queue->heap, queue->capacity * sizeof(const struct evt*));
+    assert(NULL != queue->heap);
+  }
+  // copying in heap order keeps the heap property without any sifting
+  for (size_t i = 0; i < n; ++i) {
+    struct evt* event = alloc_event(queue);
+    *event = events[i];
+    queue->heap[i] = event;
+    restored[i] = event;
+  }
+  queue->size = n;
+  queue->next_seq = next_seq;
+}
+
+
+const char* event_type_string(event_type_t type) {
+  return (type < NUM_EVENT_TYPES) ? event_type_strings[type] : "UNKNOWN";
 }
 
 
 void print_event(const struct evt* event) {
-  fprintf(stderr, "(t=%d) proc %d %s\n", event->time, event->proc->pid, event_type_strings[event->type]);
+  if (NULL == event->proc)
+    fprintf(stderr, "(t=%d) %s\n", event->time, event_type_string(event->type));
+  else
+    fprintf(stderr, "(t=%d) proc %d %s\n", event->time, event->proc->pid, event_type_string(event->type));
+}
+
+
+static int compare_events(const void* a, const void* b) {
+  const struct evt* event_a = *(const struct evt* const*)a;
+  const struct evt* event_b = *(const struct evt* const*)b;
+  if (event_before(event_a, event_b))
+    return -1;
+  return event_before(event_b, event_a);
 }
 
 
-void print_event_queue() {
+void print_event_queue(const struct event_queue* queue) {
   fprintf(stderr, "\nEVENT QUEUE\n");
 
-  for (const struct evt_node* next_event = event_queue;
-       NULL != next_event;
-       next_event = next_event->next_event) {
-    print_event(next_event->event);
+  // print a sorted copy so the output reads in the order events will be handled
+  const struct evt** sorted = malloc((queue->size + 1) * sizeof(const struct evt*));
+  if (queue->size > 0)
+    memcpy(sorted, queue->heap, queue->size * sizeof(const struct evt*));
+  qsort(sorted, queue->size, sizeof(const struct evt*), compare_events);
+  for (size_t i = 0; i < queue->size; ++i) {
+    if (!sorted[i]->cancelled)
+      print_event(sorted[i]);
   }
+  free(sorted);
 
   fprintf(stderr, "\n");
 }
-
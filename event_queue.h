@@ -2,16 +2,62 @@
 #define _EVENT_QUEUE_H_
 
 #include "event.h"
+#include "sim_stats.h"
+#include <stddef.h>
 
-struct evt_node {
-  const struct evt* event;
-  struct evt_node* next_event;
+/* The event queue is a 4-ary min-heap of events stored in one contiguous
+ * array, ordered by (time, seq).  seq is a monotonically increasing insertion
+ * counter, so events scheduled for the same time pop in FIFO order. */
+#define EVENT_HEAP_ARITY 4
+
+/* Cancelled events stay in the heap as tombstones and are discarded lazily
+ * by pop_next_event(), so cancel_event() is O(1). */
+/* Events come from a slab pool with a free list, so once the pool has grown
+ * to the peak number of pending events no further calls to malloc are made.
+ * Events returned by pop_next_event() go back to the pool via free_event(). */
+#define EVENT_SLAB_SIZE 256
+
+struct evt_slab;
+union evt_slot;
+
+/* Every simulation owns one queue; start it as EVENT_QUEUE_INIT. */
+struct event_queue {
+  const struct evt** heap;    // heap-ordered array of events
+  size_t size;
+  size_t capacity;
+  unsigned long next_seq;
+  struct evt_slab* slabs;     // every slab the pool has allocated
+  union evt_slot* free_slots; // free list threaded through the slabs
+#ifdef SIM_STATS
+  struct queue_stats stats;   // reset by the simulation, not by cleanup_event_queue()
+#endif
 };
 
-const struct evt* pop_next_event();
-void new_event(time_ticks_t time, event_type_t type, struct process* proc);
-void remove_events(pid_t pid);
-void print_event_queue();
+#ifdef SIM_STATS
+#define EVENT_QUEUE_INIT {NULL, 0, 0, 0, NULL, NULL, {0, 0, 0, 0, 0, 0, 0}}
+#else
+#define EVENT_QUEUE_INIT {NULL, 0, 0, 0, NULL, NULL}
+#endif
 
-#endif /* _EVENT_QUEUE_H_ */
+const struct evt* pop_next_event(struct event_queue* queue);
+const struct evt* peek_next_event(struct event_queue* queue); // the event pop_next_event() would return, left queued
+struct evt* new_event(struct event_queue* queue, time_ticks_t time, event_type_t type, struct process* proc);
+void cancel_event(struct evt* event);
+void free_event(struct event_queue* queue, const struct evt* event);
+void cleanup_event_queue(struct event_queue* queue);
 
+/* copy_event_queue
+ *   copies every queued event, in heap order, into events (room for
+ *   queue->size); cancelled events are copied too, so the copy is still a heap
+ */
+void copy_event_queue(const struct event_queue* queue, struct evt* events);
+
+/* restore_event_queue
+ *   replaces the queue's contents with n events from copy_event_queue() and
+ *   sets the next sequence number; restored[i] gets the new address of events[i]
+ */
+void restore_event_queue(struct event_queue* queue, const struct evt* events, size_t n,
+                         unsigned long next_seq, struct evt** restored);
+void print_event_queue(const struct event_queue* queue);
+
+#endif /* _EVENT_QUEUE_H_ */
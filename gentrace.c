@@ -0,0 +1,426 @@
+#include "process.h"
+#include "trace_bin.h"
+#include "rng.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+#include <getopt.h>
+
+/* gentrace
+ *   writes a synthetic trace, as a .proc file or in the binary format of
+ *   trace_bin.h, for scaling runs far beyond the hand-written tests.
+ *
+ * Output is streamed: memory use does not grow with the number of processes.
+ * Every process draws from its own random stream (seed, pid + 1), and the
+ * arrival times from stream 0, so any part of the trace can be regenerated
+ * on its own.  The binary format needs the burst total up front, so it is
+ * written in passes that regenerate the same values rather than storing them.
+ */
+
+typedef enum { DIST_EXPONENTIAL, DIST_PARETO } dist_kind_t;
+typedef enum { ARRIVE_POISSON, ARRIVE_BURSTY } arrival_kind_t;
+typedef enum { TICKETS_UNIFORM, TICKETS_PARETO } ticket_kind_t;
+
+struct dist {
+  dist_kind_t kind;
+  double mean;
+};
+
+struct gen_options {
+  unsigned long num_procs;
+  uint64_t seed;
+  time_ticks_t time_slice;
+  arrival_kind_t arrivals;
+  double interarrival; // mean ticks between arrivals
+  double batch_size;   // mean arrivals per batch when bursty
+  double cpu_bursts;   // mean cpu bursts per process
+  struct dist cpu;
+  struct dist io;
+  double pareto_alpha;
+  time_ticks_t max_burst;
+  ticket_kind_t ticket_dist;
+  unsigned int max_tickets;
+  int binary;
+};
+
+// the arrival process, drawn in pid order from stream 0
+struct arrivals {
+  struct rng rng;
+  uint64_t time;
+  unsigned long batch_left; // arrivals still due at the current time
+};
+
+#define TEXT_LINE_RESERVE 32 // room for one more number and its separator
+#define BURST_CHUNK 1024
+
+
+// a geometric count >= 1 with the given mean
+static unsigned long draw_count(struct rng* rng, double mean) {
+  if (mean <= 1.0)
+    return 1;
+  return 1 + (unsigned long)floor(log(rng_unit(rng)) / log(1.0 - 1.0 / mean));
+}
+
+
+static time_ticks_t draw_burst(struct rng* rng, const struct dist* dist, const struct gen_options* options) {
+  double value;
+  if (DIST_PARETO == dist->kind) {
+    // scale chosen so the mean is dist->mean; needs alpha > 1
+    double alpha = options->pareto_alpha;
+    double scale = dist->mean * (alpha - 1.0) / alpha;
+    value = scale / pow(rng_unit(rng), 1.0 / alpha);
+  } else {
+    value = -dist->mean * log(rng_unit(rng));
+  }
+  if (value < 1.0)
+    return 1;
+  if (value > options->max_burst)
+    return options->max_burst;
+  return (time_ticks_t)value;
+}
+
+
+static unsigned int draw_tickets(struct rng* rng, const struct gen_options* options) {
+  if (TICKETS_PARETO == options->ticket_dist) {
+    double value = 1.0 / pow(rng_unit(rng), 1.0 / options->pareto_alpha);
+    return (value >= options->max_tickets) ? options->max_tickets : (unsigned int)value;
+  }
+  return 1 + (unsigned int)rng_below(rng, options->max_tickets);
+}
+
+
+static int next_arrival(struct arrivals* arrivals, const struct gen_options* options, time_ticks_t* time) {
+  if (ARRIVE_BURSTY == options->arrivals) {
+    // batches arrive together, spaced so the long-run rate matches --interarrival
+    if (0 == arrivals->batch_left) {
+      arrivals->time += (uint64_t)(-options->interarrival * options->batch_size * log(rng_unit(&arrivals->rng)));
+      arrivals->batch_left = draw_count(&arrivals->rng, options->batch_size);
+    }
+    --arrivals->batch_left;
+  } else {
+    arrivals->time += (uint64_t)(-options->interarrival * log(rng_unit(&arrivals->rng)));
+  }
+  if (arrivals->time > UINT32_MAX) {
+    fprintf(stderr, "ERROR: arrival times overflow %u ticks; lower --interarrival or --procs\n", UINT32_MAX);
+    return -1;
+  }
+  *time = (time_ticks_t)arrivals->time;
+  return 0;
+}
+
+
+/* starts process pid's stream and draws what comes before its bursts; the
+ * bursts alternate cpu and I/O and always end with a cpu burst
+ */
+static void begin_process(const struct gen_options* options, unsigned long pid, struct rng* rng,
+                          uint32_t* num_bursts, unsigned int* tickets) {
+  rng_seed(rng, options->seed, (uint64_t)pid + 1);
+  unsigned long cpu_bursts = draw_count(rng, options->cpu_bursts);
+  if (cpu_bursts > UINT32_MAX / 2)
+    cpu_bursts = UINT32_MAX / 2;
+  *num_bursts = 2 * cpu_bursts - 1;
+  *tickets = draw_tickets(rng, options);
+}
+
+
+static time_ticks_t next_burst(const struct gen_options* options, struct rng* rng, uint32_t index) {
+  return draw_burst(rng, (index & 1) ? &options->io : &options->cpu, options);
+}
+
+
+static char* append_uint(char* p, unsigned long value) {
+  char digits[24];
+  char* end = &digits[sizeof(digits)];
+  char* d = end;
+  do {
+    *--d = '0' + value % 10;
+    value /= 10;
+  } while (0 != value);
+  memcpy(p, d, end - d);
+  return p + (end - d);
+}
+
+
+static int write_text(FILE* out, const struct gen_options* options) {
+  if (fprintf(out, "%u\n%lu\n", options->time_slice, options->num_procs) < 0)
+    return -1;
+
+  size_t line_size = 4096;
+  char* line = malloc(line_size);
+  assert(NULL != line);
+  struct arrivals arrivals;
+  memset(&arrivals, 0, sizeof(arrivals));
+  rng_seed(&arrivals.rng, options->seed, 0);
+
+  int result = 0;
+  for (unsigned long pid = 0; 0 == result && pid < options->num_procs; ++pid) {
+    struct rng rng;
+    uint32_t num_bursts;
+    unsigned int tickets;
+    time_ticks_t arrival_time;
+    if (0 != next_arrival(&arrivals, options, &arrival_time)) {
+      result = -1;
+      break;
+    }
+    begin_process(options, pid, &rng, &num_bursts, &tickets);
+
+    char* p = append_uint(line, tickets);
+    *p++ = ' ';
+    p = append_uint(p, arrival_time);
+    for (uint32_t i = 0; i < num_bursts; ++i) {
+      if ((size_t)(p - line) + TEXT_LINE_RESERVE > line_size) {
+        size_t used = p - line;
+        line_size *= 2;
+        line = realloc(line, line_size);
+        assert(NULL != line);
+        p = line + used;
+      }
+      *p++ = ' ';
+      p = append_uint(p, next_burst(options, &rng, i));
+    }
+    *p++ = '\n';
+    if ((size_t)(p - line) != fwrite(line, 1, p - line, out))
+      result = -1;
+  }
+  free(line);
+  return result;
+}
+
+
+static int write_binary(FILE* out, const struct gen_options* options) {
+  struct rng rng;
+  uint32_t num_bursts;
+  unsigned int tickets;
+
+  // pass 1: the header needs the burst total
+  uint64_t total_bursts = 0;
+  for (unsigned long pid = 0; pid < options->num_procs; ++pid) {
+    begin_process(options, pid, &rng, &num_bursts, &tickets);
+    total_bursts += num_bursts;
+  }
+  if (0 != write_trace_bin_header(out, options->time_slice, options->num_procs, total_bursts))
+    return -1;
+
+  // pass 2: one record per process
+  struct arrivals arrivals;
+  memset(&arrivals, 0, sizeof(arrivals));
+  rng_seed(&arrivals.rng, options->seed, 0);
+  for (unsigned long pid = 0; pid < options->num_procs; ++pid) {
+    time_ticks_t arrival_time;
+    if (0 != next_arrival(&arrivals, options, &arrival_time))
+      return -1;
+    begin_process(options, pid, &rng, &num_bursts, &tickets);
+    if (0 != write_trace_bin_proc(out, tickets, arrival_time, num_bursts))
+      return -1;
+  }
+
+  // pass 3: every process' bursts, in pid order
+  time_ticks_t chunk[BURST_CHUNK];
+  for (unsigned long pid = 0; pid < options->num_procs; ++pid) {
+    begin_process(options, pid, &rng, &num_bursts, &tickets);
+    size_t used = 0;
+    for (uint32_t i = 0; i < num_bursts; ++i) {
+      chunk[used++] = next_burst(options, &rng, i);
+      if (BURST_CHUNK == used) {
+        if (0 != write_trace_bin_bursts(out, chunk, used))
+          return -1;
+        used = 0;
+      }
+    }
+    if (used > 0 && 0 != write_trace_bin_bursts(out, chunk, used))
+      return -1;
+  }
+  return 0;
+}
+
+
+static void usage(const char* program) {
+  fprintf(stderr, "Usage: %s [options] output.proc|-\n"
+          "  --procs N            number of processes (default 1000)\n"
+          "  --seed N             random seed (default 1); the same seed gives the same trace\n"
+          "  --time-slice N       TIME_SLICE of the trace (default 100)\n"
+          "  --arrivals KIND      poisson (default) or bursty\n"
+          "  --interarrival MEAN  mean ticks between arrivals (default 10)\n"
+          "  --batch-size MEAN    mean arrivals per batch with bursty arrivals (default 20)\n"
+          "  --cpu-bursts MEAN    mean cpu bursts per process (default 4)\n"
+          "  --cpu DIST:MEAN      cpu burst lengths (default exp:100)\n"
+          "  --io DIST:MEAN       I/O burst lengths (default exp:200)\n"
+          "                       DIST is exp (exponential) or pareto (heavy-tailed)\n"
+          "  --alpha A            pareto shape, > 1; smaller is heavier (default 1.5)\n"
+          "  --max-burst N        longest burst (default 1000 times the larger mean)\n"
+          "  --tickets DIST:MAX   tickets per process: uniform or pareto, at most MAX\n"
+          "                       (default uniform:100)\n"
+          "  --binary             write the binary trace format instead of .proc text\n",
+          program);
+}
+
+
+static int parse_double(const char* text, const char* what, double min, double* value) {
+  char* endptr = NULL;
+  *value = strtod(text, &endptr);
+  if ('\0' == *text || '\0' != *endptr || !(*value >= min) || !isfinite(*value)) {
+    fprintf(stderr, "Invalid %s \"%s\"\n", what, text);
+    return -1;
+  }
+  return 0;
+}
+
+
+static int parse_ulong(const char* text, const char* what, unsigned long max, unsigned long* value) {
+  char* endptr = NULL;
+  *value = strtoul(text, &endptr, 10);
+  if ('\0' == *text || '-' == *text || '\0' != *endptr || *value > max) {
+    fprintf(stderr, "Invalid %s \"%s\"\n", what, text);
+    return -1;
+  }
+  return 0;
+}
+
+
+// parses "exp:MEAN" or "pareto:MEAN"
+static int parse_dist(const char* text, const char* what, struct dist* dist) {
+  const char* colon = strchr(text, ':');
+  if (NULL != colon && 0 == strncmp(text, "exp:", 4))
+    dist->kind = DIST_EXPONENTIAL;
+  else if (NULL != colon && 0 == strncmp(text, "pareto:", 7))
+    dist->kind = DIST_PARETO;
+  else {
+    fprintf(stderr, "Invalid %s \"%s\": expected exp:MEAN or pareto:MEAN\n", what, text);
+    return -1;
+  }
+  return parse_double(colon + 1, what, 1.0, &dist->mean);
+}
+
+
+int main(int argc, char** argv) {
+  static const struct option long_options[] = {
+    {"procs", required_argument, NULL, 'n'},
+    {"seed", required_argument, NULL, 's'},
+    {"time-slice", required_argument, NULL, 't'},
+    {"arrivals", required_argument, NULL, 'a'},
+    {"interarrival", required_argument, NULL, 'i'},
+    {"batch-size", required_argument, NULL, 'B'},
+    {"cpu-bursts", required_argument, NULL, 'k'},
+    {"cpu", required_argument, NULL, 'c'},
+    {"io", required_argument, NULL, 'o'},
+    {"alpha", required_argument, NULL, 'A'},
+    {"max-burst", required_argument, NULL, 'x'},
+    {"tickets", required_argument, NULL, 'T'},
+    {"binary", no_argument, NULL, 'b'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+  struct gen_options options = {
+    1000, 1, 100, ARRIVE_POISSON, 10.0, 20.0, 4.0,
+    {DIST_EXPONENTIAL, 100.0}, {DIST_EXPONENTIAL, 200.0}, 1.5, 0, TICKETS_UNIFORM, 100, 0
+  };
+
+  int opt;
+  unsigned long value;
+  while (-1 != (opt = getopt_long(argc, argv, "n:s:h", long_options, NULL))) {
+    int bad = 0;
+    switch (opt) {
+    case 'n':
+      bad = parse_ulong(optarg, "number of processes", UINT32_MAX, &options.num_procs);
+      break;
+    case 's':
+      bad = parse_ulong(optarg, "seed", ULONG_MAX, &value);
+      options.seed = value;
+      break;
+    case 't':
+      bad = parse_ulong(optarg, "time slice", UINT32_MAX, &value);
+      options.time_slice = value;
+      break;
+    case 'a':
+      if (0 == strcmp(optarg, "poisson"))
+        options.arrivals = ARRIVE_POISSON;
+      else if (0 == strcmp(optarg, "bursty"))
+        options.arrivals = ARRIVE_BURSTY;
+      else {
+        fprintf(stderr, "Invalid arrival process \"%s\": expected poisson or bursty\n", optarg);
+        bad = 1;
+      }
+      break;
+    case 'i':
+      bad = parse_double(optarg, "interarrival time", 0.0, &options.interarrival);
+      break;
+    case 'B':
+      bad = parse_double(optarg, "batch size", 1.0, &options.batch_size);
+      break;
+    case 'k':
+      bad = parse_double(optarg, "number of cpu bursts", 1.0, &options.cpu_bursts);
+      break;
+    case 'c':
+      bad = parse_dist(optarg, "cpu burst distribution", &options.cpu);
+      break;
+    case 'o':
+      bad = parse_dist(optarg, "I/O burst distribution", &options.io);
+      break;
+    case 'A':
+      bad = parse_double(optarg, "pareto alpha", 1.0, &options.pareto_alpha);
+      if (!bad && options.pareto_alpha <= 1.0) {
+        fprintf(stderr, "Invalid pareto alpha \"%s\": must be greater than 1\n", optarg);
+        bad = 1;
+      }
+      break;
+    case 'x':
+      bad = parse_ulong(optarg, "maximum burst", UINT32_MAX, &value) || 0 == value;
+      options.max_burst = value;
+      break;
+    case 'T': {
+      const char* colon = strchr(optarg, ':');
+      if (NULL != colon && 0 == strncmp(optarg, "uniform:", 8))
+        options.ticket_dist = TICKETS_UNIFORM;
+      else if (NULL != colon && 0 == strncmp(optarg, "pareto:", 7))
+        options.ticket_dist = TICKETS_PARETO;
+      else {
+        fprintf(stderr, "Invalid tickets \"%s\": expected uniform:MAX or pareto:MAX\n", optarg);
+        bad = 1;
+        break;
+      }
+      bad = parse_ulong(colon + 1, "maximum tickets", UINT32_MAX, &value) || 0 == value;
+      options.max_tickets = value;
+      break;
+    }
+    case 'b':
+      options.binary = 1;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      bad = 1;
+    }
+    if (bad) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind + 1 != argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (0 == options.max_burst) {
+    double longest = 1000.0 * fmax(options.cpu.mean, options.io.mean);
+    options.max_burst = (longest >= UINT32_MAX / 2) ? UINT32_MAX / 2 : (time_ticks_t)longest;
+  }
+
+  FILE* out = (0 == strcmp(argv[optind], "-")) ? stdout : fopen(argv[optind], options.binary ? "wb" : "w");
+  if (NULL == out) {
+    perror("ERROR opening output file");
+    return EXIT_FAILURE;
+  }
+  int result = options.binary ? write_binary(out, &options) : write_text(out, &options);
+  int write_failed = ferror(out);
+  if (0 != fclose(out))
+    write_failed = 1;
+  if (write_failed) {
+    perror("ERROR writing output file");
+    result = -1;
+  }
+  return (0 == result) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
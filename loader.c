@@ -0,0 +1,287 @@
+
+#include "loader.h"
+#include "trace_bin.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// whitespace characters that separate tokens on a process line: " \t\r\n"
+static const unsigned char is_delim[256] = {[' '] = 1, ['\t'] = 1, ['\r'] = 1, ['\n'] = 1};
+
+// a read-only view of the mapped file, consumed one line at a time
+struct reader {
+  const char* pos;
+  const char* end;
+};
+
+
+// returns the [start, end) span of the next line and advances past it,
+// or returns 0 at end of file
+static int next_line(struct reader* reader, const char** line, const char** line_end) {
+  if (reader->pos >= reader->end)
+    return 0;
+  *line = reader->pos;
+  // memchr is vectorized in libc, so this is the only per-byte scan for long lines
+  const char* newline = memchr(reader->pos, '\n', reader->end - reader->pos);
+  *line_end = (NULL == newline) ? reader->end : newline;
+  reader->pos = (NULL == newline) ? reader->end : newline + 1;
+  return 1;
+}
+
+
+// parses a run of decimal digits starting at *pos, advancing *pos past them
+static unsigned long parse_digits(const char** pos, const char* end) {
+  const char* p = *pos;
+  unsigned long value = 0;
+  unsigned int digit;
+  while (p < end && (digit = (unsigned char)*p - '0') < 10) {
+    value = value * 10 + digit;
+    ++p;
+  }
+  *pos = p;
+  return value;
+}
+
+
+/* reads the next whitespace-delimited token on a line as an unsigned integer
+ *
+ * returns 1 on success, 0 if the line has no more tokens,
+ * or -1 if the token is not a number (token/token_end span the bad token)
+ */
+static int next_number(const char** pos, const char* line_end, unsigned long* value,
+                       const char** token, const char** token_end) {
+  const char* p = *pos;
+  while (p < line_end && is_delim[(unsigned char)*p])
+    ++p;
+  if (p == line_end) {
+    *pos = p;
+    return 0;
+  }
+
+  *token = p;
+  *value = parse_digits(&p, line_end);
+  if (p == *token || (p < line_end && !is_delim[(unsigned char)*p])) {
+    while (p < line_end && !is_delim[(unsigned char)*p])
+      ++p;
+    *token_end = p;
+    *pos = p;
+    return -1;
+  }
+  *token_end = p;
+  *pos = p;
+  return 1;
+}
+
+
+// parses a header line: the first run of digits on the line is the value
+static int parse_header_line(struct reader* reader, const char* what, unsigned long* value) {
+  const char* line;
+  const char* line_end;
+  if (!next_line(reader, &line, &line_end)) {
+    fprintf(stderr, "ERROR reading file: missing %s line\n", what);
+    return -1;
+  }
+
+  const char* p = line;
+  while (p < line_end && (unsigned int)((unsigned char)*p - '0') >= 10)
+    ++p;
+  if (p == line_end) {
+    fprintf(stderr, "ERROR in file contents\n");
+    fprintf(stderr, "Failed to convert string \"%.*s\" to %s value\n", (int)(line_end - line), line, what);
+    return -1;
+  }
+  *value = parse_digits(&p, line_end);
+  return 0;
+}
+
+
+static double elapsed_seconds(const struct timespec* start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+
+static int parse_trace(struct reader* reader, struct trace* trace) {
+  unsigned long value = 0;
+
+  // Get the TIME_SLICE value
+  if (parse_header_line(reader, "TIME_SLICE", &value))
+    return -1;
+  trace->time_slice = value;
+
+  // Get the number of processes
+  if (parse_header_line(reader, "NUM_PROCS", &value))
+    return -1;
+  trace->num_procs = value;
+
+  // Load the processes
+  trace->procs = arena_alloc(&trace->arena, trace->num_procs * sizeof(struct process));
+  memset(trace->procs, 0, trace->num_procs * sizeof(struct process));
+
+  // bursts are parsed into a scratch buffer, then copied into the arena as
+  // one flat array per process
+  size_t scratch_capacity = 64;
+  time_ticks_t* scratch = malloc(scratch_capacity * sizeof(time_ticks_t));
+  assert(NULL != scratch);
+  int result = -1;
+
+  for (unsigned int pid = 0; pid < trace->num_procs; ++pid) {
+    struct process* proc = &trace->procs[pid];
+    proc->pid = pid;
+    proc->state = NOT_ARRIVED;
+
+    const char* line;
+    const char* line_end;
+    if (!next_line(reader, &line, &line_end)) {
+      fprintf(stderr, "ERROR reading file: expected %u processes, found %u\n", trace->num_procs, pid);
+      goto out;
+    }
+
+    const char* p = line;
+    const char* token = NULL;
+    const char* token_end = NULL;
+    int found = next_number(&p, line_end, &value, &token, &token_end);
+    if (found <= 0) {
+      fprintf(stderr, "ERROR in file contents\n");
+      if (0 == found)
+        fprintf(stderr, "No number of tickets found on process line %u\n", pid);
+      else
+        fprintf(stderr, "Failed to convert string \"%.*s\" to number of tickets\n", (int)(token_end - token), token);
+      goto out;
+    }
+    proc->tickets = value;
+
+    found = next_number(&p, line_end, &value, &token, &token_end);
+    if (found <= 0) {
+      fprintf(stderr, "ERROR in file contents\n");
+      if (0 == found)
+        fprintf(stderr, "No arrival time found on process line %u\n", pid);
+      else
+        fprintf(stderr, "Failed to convert string \"%.*s\" to arrival time\n", (int)(token_end - token), token);
+      goto out;
+    }
+    proc->arrival_time = value;
+
+    // the list of bursts starts as a CPU burst,
+    // and then alternates between CPU and I/O bursts
+    unsigned int num_bursts = 0;
+    while (0 != (found = next_number(&p, line_end, &value, &token, &token_end))) {
+      if (found < 0) {
+        fprintf(stderr, "ERROR in file contents\n");
+        fprintf(stderr, "Failed to convert string \"%.*s\" to burst time\n", (int)(token_end - token), token);
+        goto out;
+      }
+      if (num_bursts == scratch_capacity) {
+        scratch_capacity *= 2;
+        scratch = realloc(scratch, scratch_capacity * sizeof(time_ticks_t));
+        assert(NULL != scratch);
+      }
+      scratch[num_bursts++] = value;
+    }
+
+    time_ticks_t* bursts = arena_alloc(&trace->arena, num_bursts * sizeof(time_ticks_t));
+    if (num_bursts > 0)
+      memcpy(bursts, scratch, num_bursts * sizeof(time_ticks_t));
+    proc->bursts = bursts;
+    proc->num_bursts = num_bursts;
+    proc->burst_index = 0;
+    proc->remaining_time = (num_bursts > 0) ? bursts[0] : 0;
+    trace->num_bursts += num_bursts;
+  }
+  result = 0;
+
+out:
+  free(scratch);
+  return result;
+}
+
+
+int load_trace(const char* filename, struct trace* trace) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  memset(trace, 0, sizeof(struct trace));
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    perror("ERROR opening file");
+    return -1;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    perror("ERROR reading file");
+    close(fd);
+    return -1;
+  }
+  trace->file_size = file_stat.st_size;
+
+  // an empty file cannot be mapped; it fails parsing with an empty reader
+  const char* data = NULL;
+  if (trace->file_size > 0) {
+    data = mmap(NULL, trace->file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == data) {
+      perror("ERROR mapping file");
+      close(fd);
+      return -1;
+    }
+    madvise((void*)data, trace->file_size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  int result;
+  if (is_trace_bin(data, trace->file_size)) {
+    trace->is_binary = 1;
+    trace->mapping = data;
+    trace->mapping_size = trace->file_size;
+    result = parse_trace_bin(data, trace->file_size, trace);
+  } else {
+    struct reader reader = {data, (NULL == data) ? NULL : data + trace->file_size};
+    result = parse_trace(&reader, trace);
+    if (NULL != data)
+      munmap((void*)data, trace->file_size);
+  }
+
+  if (0 != result)
+    release_trace(trace);
+  trace->load_seconds = elapsed_seconds(&start);
+  return result;
+}
+
+
+void reset_trace(struct trace* trace) {
+  for (unsigned int pid = 0; pid < trace->num_procs; ++pid) {
+    struct process* proc = &trace->procs[pid];
+    proc->state = NOT_ARRIVED;
+    proc->burst_index = 0;
+    proc->remaining_time = (proc->num_bursts > 0) ? proc->bursts[0] : 0;
+    proc->cpu_event = NULL;
+    proc->cpu = -1;
+  }
+}
+
+
+void release_trace(struct trace* trace) {
+  arena_release(&trace->arena);
+  if (NULL != trace->mapping)
+    munmap((void*)trace->mapping, trace->mapping_size);
+  trace->mapping = NULL;
+  trace->mapping_size = 0;
+  trace->procs = NULL;
+  trace->num_procs = 0;
+}
+
+
+void print_load_stats(const char* filename, const struct trace* trace) {
+  double megabytes = trace->file_size / (1024.0 * 1024.0);
+  fprintf(stderr, "Loaded %s (%s): %zu bytes, %u processes, %lu bursts in %.3f ms (%.1f MB/s)\n",
+          filename, trace->is_binary ? "binary" : "text",
+          trace->file_size, trace->num_procs, trace->num_bursts,
+          trace->load_seconds * 1e3,
+          trace->load_seconds > 0 ? megabytes / trace->load_seconds : 0.0);
+}
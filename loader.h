@@ -0,0 +1,53 @@
+#ifndef _LOADER_H_
+#define _LOADER_H_
+
+#include "process.h"
+#include "arena.h"
+#include <stddef.h>
+
+/* A parsed .proc file.  procs is a contiguous table indexed by pid, with
+ * every process in its initial NOT_ARRIVED state. */
+struct trace {
+  time_ticks_t time_slice;
+  unsigned int num_procs;
+  struct process* procs;
+  struct arena arena; // owns procs and their burst arrays
+  const char* mapping; // binary traces stay mapped: their bursts point into it
+  size_t mapping_size;
+
+  // load statistics, reported by print_load_stats()
+  size_t file_size;
+  int is_binary;
+  unsigned long num_bursts;
+  double load_seconds;
+};
+
+/* load_trace
+ *   maps filename into memory and parses it into trace, detecting whether it
+ *   is a text .proc file or a binary trace (see trace_bin.h)
+ *
+ * returns 0 on success or -1 on failure, after printing what went wrong
+ *
+ * File format: line 1 holds the time slice, line 2 the number of processes,
+ * then one line per process: tickets, arrival time, then the burst lengths
+ * (CPU, I/O, CPU, ...).  Lines may be arbitrarily long.
+ */
+int load_trace(const char* filename, struct trace* trace);
+
+/* reset_trace
+ *   puts every process back in its initial NOT_ARRIVED state, so the same
+ *   trace can be simulated again without parsing it again
+ */
+void reset_trace(struct trace* trace);
+
+/* release_trace
+ *   frees every process and burst in trace at once
+ */
+void release_trace(struct trace* trace);
+
+/* print_load_stats
+ *   prints the file size and parse throughput of the last load to stderr
+ */
+void print_load_stats(const char* filename, const struct trace* trace);
+
+#endif /* _LOADER_H_ */
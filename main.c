@@ -0,0 +1,189 @@
+
+#include "simulation.h"
+#include "policy.h"
+#include "options.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <getopt.h>
+
+/* returns the name of the file a run of policy_name writes to, given the
+ * --metrics or --event-log argument.  When several policies run, each gets
+ * its own file: the policy name goes before the extension (m.json becomes
+ * m.rr.json).  The result must be freed.
+ */
+static char* per_policy_file(const char* filename, const char* policy_name, int num_policies) {
+  if (NULL == filename)
+    return NULL;
+  if (num_policies <= 1 || 0 == strcmp(filename, "-"))
+    return strdup(filename);
+
+  const char* base = strrchr(filename, '/');
+  const char* extension = strrchr((NULL == base) ? filename : base, '.');
+  size_t stem_len = (NULL == extension) ? strlen(filename) : (size_t)(extension - filename);
+  if (NULL == extension)
+    extension = "";
+
+  size_t size = strlen(filename) + strlen(policy_name) + 2;
+  char* name = malloc(size);
+  assert(NULL != name);
+  snprintf(name, size, "%.*s.%s%s", (int)stem_len, filename, policy_name, extension);
+  return name;
+}
+
+
+
+// simulates the loaded trace under one of the policies given on the command line
+static int run_policy(sim_t* sim, const struct sched_policy* policy,
+                      const struct sim_options* options, int num_policies) {
+  struct sim_options run_options = *options;
+  char* log_name = per_policy_file(options->event_log, policy->name, num_policies);
+  char* metrics_name = per_policy_file(options->metrics_file, policy->name, num_policies);
+  run_options.event_log = log_name;
+  run_options.metrics_file = metrics_name;
+
+  if (num_policies > 1)
+    printf("Policy %s\n", policy->name);
+  int result = sim_run(sim, policy, &run_options, stdout);
+  free(log_name);
+  free(metrics_name);
+  return result;
+}
+
+
+static void usage(const char* program) {
+  fprintf(stderr, "Usage: %s [options] filename.proc\n"
+          "  --policy P[,P...]  scheduling policies to run, one after another, over the trace\n"
+          "                     (default: the program name after \"sched_\"); P is a\n"
+          "                     built-in policy or the path to a policy .so\n"
+          SIM_OPTIONS_USAGE
+          "  --quiet            print only warnings and the final summary\n"
+          "  --event-log FILE   also write every event to FILE in binary form\n"
+          "  --metrics FILE     write scheduling metrics to FILE at exit\n"
+          "                     (CSV if FILE ends in .csv, otherwise JSON; - for stdout)\n"
+          "  --load-stats       report the trace file size and parse throughput\n"
+          "With several policies, each one's --event-log and --metrics file gets the\n"
+          "policy name before its extension.  Built-in policies: ",
+          program);
+  print_policies(stderr);
+}
+
+
+// the policy named by the program itself: sched_rr runs "rr"
+static const char* default_policy(const char* program) {
+  const char* base = strrchr(program, '/');
+  base = (NULL == base) ? program : base + 1;
+  if (0 == strncmp(base, "sched_", 6) && '\0' != base[6])
+    return base + 6;
+  return NULL;
+}
+
+
+int main(int argc, char** argv) {
+  static const struct option long_options[] = {
+    {"policy", required_argument, NULL, 'p'},
+    {"cpus", required_argument, NULL, 'c'},
+    {"migration-cost", required_argument, NULL, 'm'},
+    {"switch-cost", required_argument, NULL, 'X'},
+    {"decision-cost", required_argument, NULL, 'D'},
+    {"no-steal", no_argument, NULL, 'S'},
+    {"seed", required_argument, NULL, 's'},
+    {"quiet", no_argument, NULL, 'q'},
+    {"event-log", required_argument, NULL, 'E'},
+    {"metrics", required_argument, NULL, 'M'},
+    {"load-stats", no_argument, NULL, 'L'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+  struct sim_options options = {.num_cpus = 1, .work_stealing = TRUE};
+  bool_t load_stats = FALSE;
+  const char* policy_names = default_policy(argv[0]);
+
+  int opt;
+  unsigned long value;
+  while (-1 != (opt = getopt_long(argc, argv, "p:qh", long_options, NULL))) {
+    switch (opt) {
+    case 'p':
+      policy_names = optarg;
+      break;
+    case 'c':
+      if (parse_count(optarg, "number of cpus", 1, 65536, &value))
+        return EXIT_FAILURE;
+      options.num_cpus = value;
+      break;
+    case 'm':
+      if (parse_count(optarg, "migration cost", 0, SIM_MAX_SWITCH_CHARGE, &value))
+        return EXIT_FAILURE;
+      options.migration_cost = value;
+      break;
+    case 'X':
+      if (parse_count(optarg, "switch cost", 0, SIM_MAX_SWITCH_CHARGE, &value))
+        return EXIT_FAILURE;
+      options.switch_cost = value;
+      break;
+    case 'D':
+      if (parse_count(optarg, "decision cost", 0, SIM_MAX_SWITCH_CHARGE, &value))
+        return EXIT_FAILURE;
+      options.decision_cost = value;
+      break;
+    case 'S':
+      options.work_stealing = FALSE;
+      break;
+    case 's':
+      if (parse_count(optarg, "seed", 0, ULONG_MAX, &options.seed))
+        return EXIT_FAILURE;
+      break;
+    case 'q':
+      options.quiet = TRUE;
+      break;
+    case 'E':
+      options.event_log = optarg;
+      break;
+    case 'M':
+      options.metrics_file = optarg;
+      break;
+    case 'L':
+      load_stats = TRUE;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (NULL == policy_names) {
+    fprintf(stderr, "No policy given\n");
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // look every policy up before doing any work, so a typo fails fast
+  const struct sched_policy** policies = NULL;
+  int num_policies = find_policies(policy_names, &policies);
+  if (num_policies < 0) {
+    unload_policies();
+    return EXIT_FAILURE;
+  }
+
+  sim_t* sim = sim_create();
+  int status = EXIT_SUCCESS;
+  if (0 != sim_load(sim, argv[optind], load_stats))
+    status = EXIT_FAILURE;
+  for (int i = 0; EXIT_SUCCESS == status && i < num_policies; ++i) {
+    if (0 != run_policy(sim, policies[i], &options, num_policies))
+      status = EXIT_FAILURE;
+  }
+
+  sim_destroy(sim);
+  free(policies);
+  unload_policies();
+  return status;
+}
@@ -0,0 +1,249 @@
+
+#include "metrics.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+void metrics_init(struct metrics* metrics, unsigned int num_procs, unsigned int num_cpus) {
+  metrics->total_procs = num_procs;
+  metrics->procs = calloc(num_procs + 1, sizeof(struct proc_metrics));
+  assert(NULL != metrics->procs);
+  metrics->total_cpus = num_cpus;
+  metrics->cpus = calloc(num_cpus, sizeof(struct cpu_metrics));
+  assert(NULL != metrics->cpus);
+  for (unsigned int cpu = 0; cpu < num_cpus; ++cpu) {
+    metrics->cpus[cpu].idle = 1; // every cpu starts idle at t=0
+  }
+  metrics->context_switches = metrics->preemptions = metrics->idle_time = 0;
+  metrics->steals = metrics->migrations = metrics->migration_time = 0;
+  metrics->switch_time = metrics->decision_time = 0;
+}
+
+
+void metrics_arrived(struct metrics* metrics, pid_t pid, time_ticks_t time) {
+  metrics->procs[pid].arrival_time = time;
+  metrics->procs[pid].ready_since = time;
+}
+
+
+void metrics_unblocked(struct metrics* metrics, pid_t pid, time_ticks_t time) {
+  metrics->procs[pid].ready_since = time;
+}
+
+
+void metrics_dispatched(struct metrics* metrics, pid_t pid, unsigned int cpu, time_ticks_t time) {
+  struct proc_metrics* proc = &metrics->procs[pid];
+  if (0 == proc->dispatches)
+    proc->first_run = time;
+  ++proc->dispatches;
+  proc->wait_time += time - proc->ready_since;
+  ++metrics->context_switches;
+
+  if (metrics->cpus[cpu].idle) {
+    metrics->idle_time += time - metrics->cpus[cpu].idle_since;
+    metrics->cpus[cpu].idle = 0;
+  }
+}
+
+
+void metrics_preempted(struct metrics* metrics, pid_t pid, time_ticks_t time) {
+  ++metrics->preemptions;
+  metrics->procs[pid].ready_since = time;
+}
+
+
+void metrics_terminated(struct metrics* metrics, pid_t pid, time_ticks_t time) {
+  metrics->procs[pid].finish_time = time;
+  metrics->procs[pid].finished = 1;
+}
+
+
+void metrics_idle(struct metrics* metrics, unsigned int cpu, time_ticks_t time) {
+  metrics->cpus[cpu].idle = 1;
+  metrics->cpus[cpu].idle_since = time;
+}
+
+
+void metrics_stolen(struct metrics* metrics) {
+  ++metrics->steals;
+}
+
+
+void metrics_migrated(struct metrics* metrics, pid_t pid, time_ticks_t cost) {
+  ++metrics->procs[pid].migrations;
+  ++metrics->migrations;
+  metrics->migration_time += cost;
+}
+
+
+void metrics_charged(struct metrics* metrics, time_ticks_t switch_cost, time_ticks_t decision_cost) {
+  metrics->switch_time += switch_cost;
+  metrics->decision_time += decision_cost;
+}
+
+
+/* aggregate of one per-process quantity over all finished processes */
+struct summary {
+  double mean;
+  unsigned long p50;
+  unsigned long p99;
+};
+
+static int compare_ulong(const void* a, const void* b) {
+  unsigned long x = *(const unsigned long*)a;
+  unsigned long y = *(const unsigned long*)b;
+  return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of a sorted array
+static unsigned long percentile(const unsigned long* sorted, unsigned int n, unsigned int p) {
+  if (0 == n)
+    return 0;
+  unsigned long rank = ((unsigned long)p * n + 99) / 100;
+  return sorted[(rank > 0) ? rank - 1 : 0];
+}
+
+static struct summary summarize(unsigned long* values, unsigned int n) {
+  struct summary summary = {0.0, 0, 0};
+  if (0 == n)
+    return summary;
+  double total = 0.0;
+  for (unsigned int i = 0; i < n; ++i) {
+    total += values[i];
+  }
+  qsort(values, n, sizeof(unsigned long), compare_ulong);
+  summary.mean = total / n;
+  summary.p50 = percentile(values, n, 50);
+  summary.p99 = percentile(values, n, 99);
+  return summary;
+}
+
+
+static unsigned long turnaround_of(const struct proc_metrics* proc) {
+  return proc->finish_time - proc->arrival_time;
+}
+
+static unsigned long response_of(const struct proc_metrics* proc) {
+  return proc->first_run - proc->arrival_time;
+}
+
+
+static void write_summary_json(FILE* out, const char* name, struct summary summary, int last) {
+  fprintf(out, "    \"%s\": {\"mean\": %.3f, \"p50\": %lu, \"p99\": %lu}%s\n",
+          name, summary.mean, summary.p50, summary.p99, last ? "" : ",");
+}
+
+
+int metrics_write(struct metrics* metrics, const char* filename, time_ticks_t end_time) {
+  for (unsigned int cpu = 0; cpu < metrics->total_cpus; ++cpu) {
+    if (metrics->cpus[cpu].idle && end_time > metrics->cpus[cpu].idle_since) {
+      metrics->idle_time += end_time - metrics->cpus[cpu].idle_since;
+      metrics->cpus[cpu].idle_since = end_time;
+    }
+  }
+
+  // gather per-process values for the finished processes
+  unsigned long* values = malloc(3 * (metrics->total_procs + 1) * sizeof(unsigned long));
+  assert(NULL != values);
+  unsigned long* turnaround = values;
+  unsigned long* response = values + metrics->total_procs;
+  unsigned long* wait = values + 2 * metrics->total_procs;
+  unsigned int finished = 0;
+  for (unsigned int pid = 0; pid < metrics->total_procs; ++pid) {
+    if (!metrics->procs[pid].finished)
+      continue;
+    turnaround[finished] = turnaround_of(&metrics->procs[pid]);
+    response[finished] = response_of(&metrics->procs[pid]);
+    wait[finished] = metrics->procs[pid].wait_time;
+    ++finished;
+  }
+  struct summary summaries[3] = {summarize(turnaround, finished),
+                                 summarize(response, finished),
+                                 summarize(wait, finished)};
+  free(values);
+
+  int to_stdout = (0 == strcmp(filename, "-"));
+  FILE* out = to_stdout ? stdout : fopen(filename, "w");
+  if (NULL == out) {
+    perror("ERROR opening metrics file");
+    return -1;
+  }
+
+  size_t name_len = strlen(filename);
+  int csv = name_len >= 4 && 0 == strcmp(&filename[name_len - 4], ".csv");
+  double capacity = (double)end_time * metrics->total_cpus;
+  double utilization = (capacity > 0) ? (capacity - metrics->idle_time) / capacity : 0.0;
+
+  if (csv) {
+    fprintf(out, "# end_time=%u\n# cpus=%u\n# context_switches=%lu\n# preemptions=%lu\n"
+            "# cpu_idle_time=%lu\n# cpu_utilization=%.6f\n"
+            "# steals=%lu\n# migrations=%lu\n# migration_time=%lu\n# switch_time=%lu\n# decision_time=%lu\n",
+            end_time, metrics->total_cpus, metrics->context_switches, metrics->preemptions, metrics->idle_time, utilization,
+            metrics->steals, metrics->migrations, metrics->migration_time, metrics->switch_time, metrics->decision_time);
+    fprintf(out, "pid,arrival,first_run,finish,turnaround,response,wait,dispatches,migrations\n");
+    for (unsigned int pid = 0; pid < metrics->total_procs; ++pid) {
+      const struct proc_metrics* proc = &metrics->procs[pid];
+      if (proc->finished)
+        fprintf(out, "%u,%u,%u,%u,%lu,%lu,%lu,%u,%u\n", pid, proc->arrival_time, proc->first_run,
+                proc->finish_time, turnaround_of(proc), response_of(proc), proc->wait_time, proc->dispatches,
+                proc->migrations);
+      else
+        fprintf(out, "%u,%u,,,,,%lu,%u,%u\n", pid, proc->arrival_time, proc->wait_time, proc->dispatches,
+                proc->migrations);
+    }
+    // aggregate rows line up with the turnaround, response and wait columns
+    fprintf(out, "mean,,,,%.3f,%.3f,%.3f,,\n", summaries[0].mean, summaries[1].mean, summaries[2].mean);
+    fprintf(out, "p50,,,,%lu,%lu,%lu,,\n", summaries[0].p50, summaries[1].p50, summaries[2].p50);
+    fprintf(out, "p99,,,,%lu,%lu,%lu,,\n", summaries[0].p99, summaries[1].p99, summaries[2].p99);
+
+  } else {
+    fprintf(out, "{\n  \"end_time\": %u,\n  \"cpus\": %u,\n  \"context_switches\": %lu,\n  \"preemptions\": %lu,\n"
+            "  \"cpu_idle_time\": %lu,\n  \"cpu_utilization\": %.6f,\n"
+            "  \"steals\": %lu,\n  \"migrations\": %lu,\n  \"migration_time\": %lu,\n"
+            "  \"switch_time\": %lu,\n  \"decision_time\": %lu,\n  \"finished\": %u,\n",
+            end_time, metrics->total_cpus, metrics->context_switches, metrics->preemptions, metrics->idle_time, utilization,
+            metrics->steals, metrics->migrations, metrics->migration_time, metrics->switch_time, metrics->decision_time,
+            finished);
+    fprintf(out, "  \"aggregate\": {\n");
+    write_summary_json(out, "turnaround", summaries[0], 0);
+    write_summary_json(out, "response", summaries[1], 0);
+    write_summary_json(out, "wait", summaries[2], 1);
+    fprintf(out, "  },\n  \"processes\": [\n");
+    for (unsigned int pid = 0; pid < metrics->total_procs; ++pid) {
+      const struct proc_metrics* proc = &metrics->procs[pid];
+      fprintf(out, "    {\"pid\": %u, \"arrival\": %u, \"dispatches\": %u, \"migrations\": %u, \"wait\": %lu",
+              pid, proc->arrival_time, proc->dispatches, proc->migrations, proc->wait_time);
+      if (proc->finished)
+        fprintf(out, ", \"first_run\": %u, \"finish\": %u, \"turnaround\": %lu, \"response\": %lu",
+                proc->first_run, proc->finish_time, turnaround_of(proc), response_of(proc));
+      fprintf(out, "}%s\n", (pid + 1 < metrics->total_procs) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+  }
+
+  if (to_stdout)
+    return (0 == fflush(out)) ? 0 : -1;
+  return (0 == fclose(out)) ? 0 : -1;
+}
+
+
+void metrics_copy(struct metrics* copy, const struct metrics* metrics) {
+  *copy = *metrics;
+  copy->procs = malloc((metrics->total_procs + 1) * sizeof(struct proc_metrics));
+  assert(NULL != copy->procs);
+  memcpy(copy->procs, metrics->procs, (metrics->total_procs + 1) * sizeof(struct proc_metrics));
+  copy->cpus = malloc(metrics->total_cpus * sizeof(struct cpu_metrics));
+  assert(NULL != copy->cpus);
+  memcpy(copy->cpus, metrics->cpus, metrics->total_cpus * sizeof(struct cpu_metrics));
+}
+
+
+void metrics_cleanup(struct metrics* metrics) {
+  free(metrics->procs);
+  metrics->procs = NULL;
+  metrics->total_procs = 0;
+  free(metrics->cpus);
+  metrics->cpus = NULL;
+  metrics->total_cpus = 0;
+}
@@ -0,0 +1,69 @@
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "process.h"
+
+/* Scheduling metrics are accumulated as the simulation runs: the event loop
+ * and context_switch() report each state change as it happens, so producing
+ * the summary never needs another pass over the trace. */
+
+struct proc_metrics {
+  time_ticks_t arrival_time;
+  time_ticks_t first_run;   // valid once dispatches > 0
+  time_ticks_t finish_time; // valid once finished
+  time_ticks_t ready_since; // when the process last became READY without running
+  unsigned long wait_time;  // total time spent READY but not running
+  unsigned int dispatches;
+  unsigned int migrations;  // dispatches onto a different cpu than the last one
+  int finished;
+};
+
+struct cpu_metrics {
+  time_ticks_t idle_since;
+  int idle;
+};
+
+/* the metrics of one simulation; set up by metrics_init() */
+struct metrics {
+  struct proc_metrics* procs; // indexed by pid
+  unsigned int total_procs;
+  struct cpu_metrics* cpus;
+  unsigned int total_cpus;
+
+  unsigned long context_switches;
+  unsigned long preemptions;
+  unsigned long idle_time;      // summed over all cpus
+  unsigned long steals;
+  unsigned long migrations;
+  unsigned long migration_time; // ticks of migration cost charged
+  unsigned long switch_time;    // ticks of context switch cost charged
+  unsigned long decision_time;  // ticks of scheduling decision cost charged
+};
+
+void metrics_init(struct metrics* metrics, unsigned int num_procs, unsigned int num_cpus);
+void metrics_arrived(struct metrics* metrics, pid_t pid, time_ticks_t time);
+void metrics_unblocked(struct metrics* metrics, pid_t pid, time_ticks_t time);
+void metrics_dispatched(struct metrics* metrics, pid_t pid, unsigned int cpu, time_ticks_t time); // context switched onto cpu
+void metrics_preempted(struct metrics* metrics, pid_t pid, time_ticks_t time);  // switched off its cpu while still READY
+void metrics_terminated(struct metrics* metrics, pid_t pid, time_ticks_t time);
+void metrics_idle(struct metrics* metrics, unsigned int cpu, time_ticks_t time); // cpu just went idle
+void metrics_stolen(struct metrics* metrics);                                  // a process moved to an idle cpu's queue
+void metrics_migrated(struct metrics* metrics, pid_t pid, time_ticks_t cost);    // dispatched on a new cpu, charged cost
+void metrics_charged(struct metrics* metrics, time_ticks_t switch_cost, time_ticks_t decision_cost); // for one dispatch or decision
+
+/* metrics_write
+ *   writes the per-process and aggregate summary to filename ("-" for
+ *   stdout), as CSV if the name ends in ".csv" and as JSON otherwise
+ *
+ * returns 0 on success or -1 on failure
+ */
+int metrics_write(struct metrics* metrics, const char* filename, time_ticks_t end_time);
+
+/* metrics_copy
+ *   makes copy a separate copy of metrics, to be freed with metrics_cleanup()
+ */
+void metrics_copy(struct metrics* copy, const struct metrics* metrics);
+
+void metrics_cleanup(struct metrics* metrics);
+
+#endif /* _METRICS_H_ */
@@ -0,0 +1,15 @@
+
+#include "options.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int parse_count(const char* text, const char* what, unsigned long min, unsigned long max, unsigned long* value) {
+  char* endptr = NULL;
+  *value = strtoul(text, &endptr, 10);
+  // strtoul() would accept "-1" as ULONG_MAX
+  if ('\0' == *text || '-' == *text || '\0' != *endptr || *value < min || *value > max) {
+    fprintf(stderr, "Invalid %s \"%s\"\n", what, text);
+    return -1;
+  }
+  return 0;
+}
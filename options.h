@@ -0,0 +1,26 @@
+#ifndef _OPTIONS_H_
+#define _OPTIONS_H_
+
+/* Command-line handling shared by the simulator drivers (simulate, batch and
+ * simbench). */
+
+/* usage text for the struct sim_options settings that simulate and batch
+ * both take */
+#define SIM_OPTIONS_USAGE \
+  "  --cpus N           simulate N cpus (default 1)\n" \
+  "  --migration-cost N add N ticks to a cpu burst each time it moves to another cpu\n" \
+  "  --switch-cost N    add N ticks to a cpu burst each time it is switched to\n" \
+  "  --decision-cost N  charge each scheduler call N ticks, plus N for every process\n" \
+  "                     waiting in the ready queue it decided from\n" \
+  "  --no-steal         do not let idle cpus take work from other cpus' queues\n" \
+  "  --seed N           seed for policies that make random choices (default 0)\n"
+
+/* parse_count
+ *   reads text, a decimal number from min to max, into *value; what names
+ *   the setting in the error message
+ *
+ * returns 0 on success or -1 after printing what was wrong with text
+ */
+int parse_count(const char* text, const char* what, unsigned long min, unsigned long max, unsigned long* value);
+
+#endif /* _OPTIONS_H_ */
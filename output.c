@@ -0,0 +1,180 @@
+
+#include "output.h"
+#include <assert.h>
+#include <endian.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define EVENT_LOG_BATCH 4096
+
+static void flush_buffer(struct output* output) {
+  if (output->used > 0)
+    fwrite(output->buffer, 1, output->used, output->out);
+  output->used = 0;
+#ifdef DEBUG
+  fflush(output->out); // keep stdout in step with the debug output on stderr
+#endif // DEBUG
+}
+
+
+static void flush_log(struct output* output) {
+  if (output->log_used > 0)
+    fwrite(output->log_batch, sizeof(struct event_log_record), output->log_used, output->log_file);
+  output->log_used = 0;
+}
+
+
+static inline void put_str(struct output* output, const char* str, size_t len) {
+  memcpy(&output->buffer[output->used], str, len);
+  output->used += len;
+}
+
+#define PUT_LITERAL(str) put_str(output, str, sizeof(str) - 1)
+
+
+// formats value the way printf's %d does
+static inline void put_int(struct output* output, int value) {
+  char digits[12];
+  char* end = &digits[sizeof(digits)];
+  char* p = end;
+  unsigned int magnitude = (value < 0) ? -(unsigned int)value : (unsigned int)value;
+  do {
+    *--p = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude > 0);
+  if (value < 0)
+    *--p = '-';
+  put_str(output, p, end - p);
+}
+
+
+int output_open(struct output* output, FILE* out, int quiet, const char* event_log, int show_cpu) {
+  memset(output, 0, sizeof(struct output));
+  // the event log is opened first, so a failure leaves nothing to free
+  if (NULL != event_log) {
+    output->log_file = fopen(event_log, "wb");
+    if (NULL == output->log_file) {
+      perror("ERROR opening event log");
+      return -1;
+    }
+    uint32_t version = htole32(EVENT_LOG_VERSION);
+    if (1 != fwrite(EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC) - 1, 1, output->log_file)
+        || 1 != fwrite(&version, sizeof(version), 1, output->log_file)
+        || 0 != fflush(output->log_file)) {
+      perror("ERROR writing event log header");
+      fclose(output->log_file);
+      output->log_file = NULL;
+      return -1;
+    }
+    output->log_batch = malloc(EVENT_LOG_BATCH * sizeof(struct event_log_record));
+    assert(NULL != output->log_batch);
+    output->log_used = 0;
+  }
+
+  output->out = out;
+  output->quiet = quiet;
+  output->show_cpu = show_cpu;
+  output->buffer = malloc(OUTPUT_BUFFER_SIZE);
+  assert(NULL != output->buffer);
+  output->used = 0;
+  return 0;
+}
+
+
+void output_event(struct output* output, out_event_t type, time_ticks_t time, pid_t pid, int cpu) {
+  if (NULL != output->log_file) {
+    struct event_log_record* record = &output->log_batch[output->log_used++];
+    record->time = htole32(time);
+    record->pid = htole32((OUT_IDLE == type) ? -1 : pid);
+    record->type = htole32(type);
+    record->cpu = htole32(cpu);
+    if (EVENT_LOG_BATCH == output->log_used)
+      flush_log(output);
+  }
+
+  if (output->quiet)
+    return;
+  // the longest line is "(t=-2147483648) running proc -2147483648 on cpu -2147483648\n"
+  if (output->used + 80 > OUTPUT_BUFFER_SIZE)
+    flush_buffer(output);
+
+  PUT_LITERAL("(t=");
+  put_int(output, time);
+  switch (type) {
+  case OUT_ARRIVED:
+    PUT_LITERAL(") proc ");
+    put_int(output, pid);
+    PUT_LITERAL(" arrived\n");
+    break;
+  case OUT_RUNNING:
+    PUT_LITERAL(") running proc ");
+    put_int(output, pid);
+    if (output->show_cpu) {
+      PUT_LITERAL(" on cpu ");
+      put_int(output, cpu);
+    }
+    PUT_LITERAL("\n");
+    break;
+  case OUT_BLOCKED:
+    PUT_LITERAL(") proc ");
+    put_int(output, pid);
+    PUT_LITERAL(" blocked for I/O\n");
+    break;
+  case OUT_FINISHED_IO:
+    PUT_LITERAL(") proc ");
+    put_int(output, pid);
+    PUT_LITERAL(" finished I/O\n");
+    break;
+  case OUT_IDLE:
+    if (output->show_cpu) {
+      PUT_LITERAL(") cpu ");
+      put_int(output, cpu);
+      PUT_LITERAL(" idle\n");
+    } else {
+      PUT_LITERAL(") idle\n");
+    }
+    break;
+  }
+#ifdef DEBUG
+  flush_buffer(output);
+#endif // DEBUG
+}
+
+
+void output_printf(struct output* output, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(&output->buffer[output->used], OUTPUT_BUFFER_SIZE - output->used, format, args);
+  va_end(args);
+
+  if (len >= 0 && (size_t)len >= OUTPUT_BUFFER_SIZE - output->used) {
+    // did not fit: flush and write it straight through
+    flush_buffer(output);
+    va_start(args, format);
+    vfprintf(output->out, format, args);
+    va_end(args);
+  } else if (len > 0) {
+    output->used += len;
+  }
+#ifdef DEBUG
+  flush_buffer(output);
+#endif // DEBUG
+}
+
+
+void output_close(struct output* output) {
+  if (NULL != output->buffer) {
+    flush_buffer(output);
+    fflush(output->out);
+    free(output->buffer);
+    output->buffer = NULL;
+  }
+  if (NULL != output->log_file) {
+    flush_log(output);
+    fclose(output->log_file);
+    output->log_file = NULL;
+    free(output->log_batch);
+    output->log_batch = NULL;
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef _OUTPUT_H_
+#define _OUTPUT_H_
+
+#include "process.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/* Trace output goes through a large user-space buffer and is formatted by
+ * hand, so the event loop never parses a format string.  The text written
+ * is byte-identical to the printf calls it replaces. */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+typedef enum {OUT_ARRIVED, OUT_RUNNING, OUT_BLOCKED, OUT_FINISHED_IO, OUT_IDLE} out_event_t;
+
+struct event_log_record;
+
+/* the output of one simulation; set up by output_open() */
+struct output {
+  FILE* out;
+  int quiet;
+  int show_cpu;
+  char* buffer;   // OUTPUT_BUFFER_SIZE bytes
+  size_t used;
+
+  FILE* log_file; // NULL unless an event log was requested
+  struct event_log_record* log_batch;
+  size_t log_used;
+};
+
+/* output_open
+ *   starts writing output to out (normally stdout).  In quiet mode the per-event
+ *   lines are dropped and only warnings and the final summary are written.
+ *   If event_log is not NULL every event is also appended to it in the
+ *   compact binary form below.  show_cpu adds the cpu to the running and
+ *   idle lines; it is off for single-cpu runs so their output is unchanged.
+ *
+ * returns 0 on success, or -1 if event_log cannot be opened or its header
+ * cannot be written, in which case nothing is left to close
+ */
+int output_open(struct output* output, FILE* out, int quiet, const char* event_log, int show_cpu);
+
+/* output_event
+ *   records one scheduling event; pid is ignored for OUT_IDLE and cpu is
+ *   only printed for OUT_RUNNING and OUT_IDLE
+ */
+void output_event(struct output* output, out_event_t type, time_ticks_t time, pid_t pid, int cpu);
+
+/* output_printf
+ *   writes free-form text (warnings, the final summary) in order with events
+ */
+void output_printf(struct output* output, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/* output_close
+ *   flushes everything and closes the event log
+ */
+void output_close(struct output* output);
+
+
+/* Binary event log: an 8-byte magic and a little-endian uint32 version,
+ * followed by one struct event_log_record per event. */
+#define EVENT_LOG_MAGIC "SCHEDLOG"
+#define EVENT_LOG_VERSION 2
+
+struct event_log_record {
+  uint32_t time;
+  int32_t pid;   // -1 for OUT_IDLE
+  uint32_t type; // out_event_t
+  int32_t cpu;   // cpu the process runs or last ran on, or -1
+};
+
+#endif /* _OUTPUT_H_ */
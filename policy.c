@@ -0,0 +1,140 @@
+
+#include "policy.h"
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+extern const struct sched_policy rr_policy;
+extern const struct sched_policy stcf_policy;
+extern const struct sched_policy stride_policy;
+extern const struct sched_policy lottery_policy;
+extern const struct sched_policy mlfq_policy;
+extern const struct sched_policy cfs_policy;
+
+static const struct sched_policy* const builtin_policies[] = {
+  &rr_policy,
+  &stcf_policy,
+  &stride_policy,
+  &lottery_policy,
+  &mlfq_policy,
+  &cfs_policy,
+};
+
+#define NUM_BUILTIN_POLICIES (sizeof(builtin_policies) / sizeof(builtin_policies[0]))
+
+// handles of every shared object opened so far
+static void** handles = NULL;
+static size_t num_handles = 0;
+
+
+static int is_shared_object(const char* name) {
+  size_t len = strlen(name);
+  return NULL != strchr(name, '/') || (len > 3 && 0 == strcmp(&name[len - 3], ".so"));
+}
+
+
+// builds "<stem>_policy" from a path like dir/sched_stem.so
+static char* stem_symbol(const char* path) {
+  const char* base = strrchr(path, '/');
+  base = (NULL == base) ? path : base + 1;
+  if (0 == strncmp(base, "sched_", 6))
+    base += 6;
+  size_t len = strlen(base);
+  if (len > 3 && 0 == strcmp(&base[len - 3], ".so"))
+    len -= 3;
+
+  char* symbol = malloc(len + sizeof("_policy"));
+  assert(NULL != symbol);
+  memcpy(symbol, base, len);
+  strcpy(&symbol[len], "_policy");
+  return symbol;
+}
+
+
+static const struct sched_policy* load_policy(const char* path) {
+  void* handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (NULL == handle) {
+    fprintf(stderr, "ERROR loading policy: %s\n", dlerror());
+    return NULL;
+  }
+
+  const struct sched_policy* policy = dlsym(handle, "sched_policy");
+  if (NULL == policy) {
+    char* symbol = stem_symbol(path);
+    policy = dlsym(handle, symbol);
+    if (NULL == policy)
+      fprintf(stderr, "ERROR loading policy: %s exports neither sched_policy nor %s\n", path, symbol);
+    free(symbol);
+  }
+  if (NULL == policy) {
+    dlclose(handle);
+    return NULL;
+  }
+
+  handles = realloc(handles, (num_handles + 1) * sizeof(void*));
+  assert(NULL != handles);
+  handles[num_handles++] = handle;
+  return policy;
+}
+
+
+const struct sched_policy* find_policy(const char* name) {
+  if (is_shared_object(name))
+    return load_policy(name);
+
+  for (size_t i = 0; i < NUM_BUILTIN_POLICIES; ++i) {
+    if (0 == strcmp(builtin_policies[i]->name, name))
+      return builtin_policies[i];
+  }
+  fprintf(stderr, "Unknown policy \"%s\"\n", name);
+  return NULL;
+}
+
+
+int find_policies(const char* names, const struct sched_policy*** policies) {
+  char* copy = strdup(names);
+  assert(NULL != copy);
+  size_t max_policies = 1;
+  for (const char* c = copy; '\0' != *c; ++c)
+    max_policies += (',' == *c);
+  *policies = malloc(max_policies * sizeof(const struct sched_policy*));
+  assert(NULL != *policies);
+
+  int num_policies = 0;
+  int failed = 0;
+  for (char* save = NULL, *name = strtok_r(copy, ",", &save); NULL != name; name = strtok_r(NULL, ",", &save)) {
+    if (NULL == ((*policies)[num_policies++] = find_policy(name)))
+      failed = 1;
+  }
+  free(copy);
+  if (0 == num_policies) {
+    fprintf(stderr, "No policy given\n");
+    failed = 1;
+  }
+  if (failed) {
+    free(*policies);
+    *policies = NULL;
+    return -1;
+  }
+  return num_policies;
+}
+
+
+void print_policies(FILE* out) {
+  for (size_t i = 0; i < NUM_BUILTIN_POLICIES; ++i) {
+    fprintf(out, "%s%s", (i > 0) ? ", " : "", builtin_policies[i]->name);
+  }
+  fprintf(out, "\n");
+}
+
+
+void unload_policies() {
+  for (size_t i = 0; i < num_handles; ++i) {
+    dlclose(handles[i]);
+  }
+  free(handles);
+  handles = NULL;
+  num_handles = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef _POLICY_H_
+#define _POLICY_H_
+
+#include "scheduler.h"
+#include <stdio.h>
+
+/* The policies one simulator binary can run.  The built-in policies are
+ * linked in; any other policy is loaded from a shared object on demand. */
+
+/* find_policy
+ *   looks up a built-in policy by name, or loads name with dlopen if it looks
+ *   like a path to a shared object (it contains a '/' or ends in ".so").
+ *   A shared object must export its policy as "sched_policy" or as
+ *   "<stem>_policy", where stem is the file name without a leading "sched_"
+ *   and the ".so" (so sched_rr.so may export rr_policy).
+ *
+ * returns the policy, or NULL after printing what went wrong
+ */
+const struct sched_policy* find_policy(const char* name);
+
+/* find_policies
+ *   looks up every policy in a comma-separated list with find_policy() and
+ *   stores them in a new array in *policies, which the caller frees
+ *
+ * returns the number of policies, or -1 after printing what went wrong
+ */
+int find_policies(const char* names, const struct sched_policy*** policies);
+
+/* print_policies
+ *   lists the built-in policy names on out
+ */
+void print_policies(FILE* out);
+
+/* unload_policies
+ *   closes every shared object opened by find_policy(); policies found
+ *   earlier must not be used afterwards
+ */
+void unload_policies();
+
+#endif /* _POLICY_H_ */
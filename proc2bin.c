@@ -0,0 +1,37 @@
+
+#include "loader.h"
+#include "trace_bin.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+/* proc2bin
+ *   converts a .proc file into the binary trace format described in
+ *   trace_bin.h, which the simulators detect and map without parsing
+ */
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s input.proc output.bin\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  struct trace trace;
+  if (0 != load_trace(argv[1], &trace))
+    return EXIT_FAILURE;
+
+  FILE* out = (0 == strcmp(argv[2], "-")) ? stdout : fopen(argv[2], "wb");
+  if (NULL == out) {
+    perror("ERROR opening output file");
+    release_trace(&trace);
+    return EXIT_FAILURE;
+  }
+
+  int result = write_trace_bin(out, &trace);
+  if (0 != fclose(out))
+    result = -1;
+  if (0 != result)
+    perror("ERROR writing output file");
+
+  release_trace(&trace);
+  return (0 == result) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -10,10 +10,9 @@ const char* burst_strings[] = {"CPU", "I/O"};
 void print_process(const struct process* proc) {
   fprintf(stderr, "\tPROCESS\n\tpid: %d\n\tstate: %s\n\ttickets: %d\n\tarrival time: %d\n",
           proc->pid, state_strings[proc->state], proc->tickets, proc->arrival_time);
-  const struct burst* next_burst = proc->current_burst;
-  while (NULL != next_burst) {
-    fprintf(stderr, "\t%s burst: %d\n", burst_strings[next_burst->type], next_burst->remaining_time);
-    next_burst = next_burst->next_burst;
+  for (unsigned int i = proc->burst_index; i < proc->num_bursts; ++i) {
+    time_ticks_t remaining_time = (i == proc->burst_index) ? proc->remaining_time : proc->bursts[i];
+    fprintf(stderr, "\t%s burst: %d\n", burst_strings[i & 1], remaining_time);
   }
 }
 
@@ -5,27 +5,47 @@ typedef unsigned int time_ticks_t;
 typedef int pid_t;
 
 
+/* A process' bursts are stored as one flat array of lengths.  The list
+ * starts with a CPU burst and then alternates, so the burst type is just the
+ * parity of its index. */
 typedef enum {CPU_BURST=0, IO_BURST=1} burst_type_t;
 
-struct burst {
-  burst_type_t type;
-  time_ticks_t remaining_time;
-  struct burst* next_burst;
-};
-
 
 typedef enum {NOT_ARRIVED, READY, BLOCKED, TERMINATED} state_t;
 
+struct evt;
+
+/* Processes live in one contiguous table indexed by pid.  The fields the
+ * event loop and the policies touch on every event come first so they share
+ * a cache line. */
 struct process {
   pid_t pid;
   state_t state;
   unsigned int tickets;
+  time_ticks_t remaining_time; // time left in the current burst
+  unsigned int burst_index;    // cursor into bursts; == num_bursts once all are done
+  unsigned int num_bursts;
+  const time_ticks_t* bursts;  // original length of every burst
+  struct evt* cpu_event; // pending FINISH_CPU or FINISH_TIME_SLICE event, or NULL
+  int cpu;               // cpu the process is running on or last ran on, or -1
   time_ticks_t arrival_time;
-  struct burst* current_burst;
 };
 
 
+/* burst accessors; use these rather than indexing bursts directly */
+static inline int proc_has_burst(const struct process* proc) {
+  return proc->burst_index < proc->num_bursts;
+}
+
+static inline burst_type_t proc_burst_type(const struct process* proc) {
+  return (burst_type_t)(proc->burst_index & 1);
+}
+
+static inline time_ticks_t proc_remaining_time(const struct process* proc) {
+  return proc->remaining_time;
+}
+
+
 void print_process(const struct process* proc);
 
 #endif /* _PROCESS_H_ */
-
@@ -0,0 +1,54 @@
+
+#include "rng.h"
+
+static uint64_t rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+
+// splitmix64: spreads a seed over the whole state so nearby seeds differ
+static uint64_t splitmix64(uint64_t* x) {
+  uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+
+void rng_seed(struct rng* rng, uint64_t seed, uint64_t stream) {
+  uint64_t x = seed ^ splitmix64(&stream);
+  for (int i = 0; i < 4; ++i) {
+    rng->state[i] = splitmix64(&x);
+  }
+}
+
+
+uint64_t rng_next(struct rng* rng) {
+  uint64_t* s = rng->state;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+
+uint64_t rng_below(struct rng* rng, uint64_t bound) {
+  // reject the top sliver of the range that would bias the remainder
+  uint64_t threshold = -bound % bound;
+  uint64_t x;
+  do {
+    x = rng_next(rng);
+  } while (x < threshold);
+  return x % bound;
+}
+
+
+double rng_unit(struct rng* rng) {
+  // 53 random bits, offset by half a step so 0 and 1 never come out
+  return ((rng_next(rng) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,36 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+
+#include <stdint.h>
+
+/* A small, fast, seedable pseudo-random generator (xoshiro256**).  The same
+ * seed and stream always give the same sequence on every platform, so a
+ * seed is enough to reproduce a generated trace or a lottery draw.  Separate
+ * streams of one seed are independent, which lets a value be regenerated
+ * without replaying everything drawn before it. */
+
+struct rng {
+  uint64_t state[4];
+};
+
+/* rng_seed
+ *   starts rng on the sequence for (seed, stream)
+ */
+void rng_seed(struct rng* rng, uint64_t seed, uint64_t stream);
+
+/* rng_next
+ *   returns the next 64 random bits
+ */
+uint64_t rng_next(struct rng* rng);
+
+/* rng_below
+ *   returns a uniformly distributed integer in [0, bound); bound must be > 0
+ */
+uint64_t rng_below(struct rng* rng, uint64_t bound);
+
+/* rng_unit
+ *   returns a uniformly distributed double in (0, 1)
+ */
+double rng_unit(struct rng* rng);
+
+#endif /* _RNG_H_ */
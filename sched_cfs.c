@@ -0,0 +1,459 @@
+#include "scheduler.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+// Completely fair scheduling: each process accumulates virtual runtime, the
+// cpu time it has had divided by its weight (its tickets), and a cpu always
+// runs the READY process with the least.  Over time every process gets cpu in
+// proportion to its tickets.
+//
+// The waiting processes are kept in a red-black tree ordered by vruntime, with
+// the leftmost node cached, so picking the next process is O(1) and queueing
+// one is O(log n).  The time slice is not fixed: each dispatch is given the
+// target latency divided among the runnable processes, but never less than
+// the minimum granularity.  Both are multiples of the trace's time slice and
+// can be set at build time, e.g. -DCFS_LATENCY_SLICES=8.
+
+#ifndef CFS_LATENCY_SLICES
+#define CFS_LATENCY_SLICES 4     // target latency, in trace time slices
+#endif
+#ifndef CFS_GRANULARITY_DIVISOR
+#define CFS_GRANULARITY_DIVISOR 2 // minimum granularity is the trace time slice over this
+#endif
+
+#define VRUNTIME_SCALE (1ull << 20) // vruntime per tick at a weight of 1
+
+typedef struct cfs_proc {
+    const struct process* proc;  // NULL until the process arrives
+    unsigned long long vruntime;
+    unsigned long seq;           // when it was last queued; breaks vruntime ties first-come first-served
+    unsigned int weight;
+    time_ticks_t started;        // when it was last dispatched or charged
+    int runnable;                // READY, running or waiting
+    int queued;                  // in the tree
+    struct cfs_proc* parent;
+    struct cfs_proc* left;
+    struct cfs_proc* right;
+    int red;
+} cfs_proc_t;
+
+// the state of one simulation
+typedef struct {
+    cfs_proc_t* root;
+    cfs_proc_t* leftmost;        // the next process to run, or NULL
+    cfs_proc_t* procs;           // indexed by pid
+    unsigned int num_procs;
+    unsigned int runnable;       // READY processes, running or waiting
+    unsigned long next_seq;
+    unsigned long long min_vruntime; // never decreases; where arriving and waking processes start
+    time_ticks_t latency;
+    time_ticks_t granularity;
+} Cfs;
+
+static int runs_before(const cfs_proc_t* a, const cfs_proc_t* b) {
+    if (a->vruntime != b->vruntime) return a->vruntime < b->vruntime;
+    return a->seq < b->seq;
+}
+
+static int is_red(const cfs_proc_t* node) {
+    return node && node->red;
+}
+
+static void rotate_left(Cfs* cfs, cfs_proc_t* x) {
+    cfs_proc_t* y = x->right;
+    x->right = y->left;
+    if (y->left) y->left->parent = x;
+    y->parent = x->parent;
+    if (!x->parent) cfs->root = y;
+    else if (x == x->parent->left) x->parent->left = y;
+    else x->parent->right = y;
+    y->left = x;
+    x->parent = y;
+}
+
+static void rotate_right(Cfs* cfs, cfs_proc_t* x) {
+    cfs_proc_t* y = x->left;
+    x->left = y->right;
+    if (y->right) y->right->parent = x;
+    y->parent = x->parent;
+    if (!x->parent) cfs->root = y;
+    else if (x == x->parent->right) x->parent->right = y;
+    else x->parent->left = y;
+    y->right = x;
+    x->parent = y;
+}
+
+// Queue a process in vruntime order, behind any with the same vruntime
+static void enqueue(Cfs* cfs, cfs_proc_t* node) {
+    assert(!node->queued);
+    node->queued = 1;
+    node->seq = cfs->next_seq++;
+    node->left = node->right = NULL;
+    node->red = 1;
+
+    cfs_proc_t* parent = NULL;
+    cfs_proc_t** link = &cfs->root;
+    int leftmost = 1;
+    while (*link) {
+        parent = *link;
+        if (runs_before(node, parent)) {
+            link = &parent->left;
+        } else {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+    node->parent = parent;
+    *link = node;
+    if (leftmost) cfs->leftmost = node;
+
+    // restore the red-black properties
+    while (is_red(node->parent)) {
+        cfs_proc_t* p = node->parent;
+        cfs_proc_t* g = p->parent;
+        if (p == g->left) {
+            cfs_proc_t* uncle = g->right;
+            if (is_red(uncle)) {
+                p->red = uncle->red = 0;
+                g->red = 1;
+                node = g;
+                continue;
+            }
+            if (node == p->right) {
+                rotate_left(cfs, p);
+                node = p;
+                p = node->parent;
+            }
+            p->red = 0;
+            g->red = 1;
+            rotate_right(cfs, g);
+        } else {
+            cfs_proc_t* uncle = g->left;
+            if (is_red(uncle)) {
+                p->red = uncle->red = 0;
+                g->red = 1;
+                node = g;
+                continue;
+            }
+            if (node == p->left) {
+                rotate_right(cfs, p);
+                node = p;
+                p = node->parent;
+            }
+            p->red = 0;
+            g->red = 1;
+            rotate_left(cfs, g);
+        }
+    }
+    cfs->root->red = 0;
+}
+
+static cfs_proc_t* next_node(cfs_proc_t* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) node = node->left;
+        return node;
+    }
+    while (node->parent && node == node->parent->right) node = node->parent;
+    return node->parent;
+}
+
+// Put v where u was in u's parent
+static void transplant(Cfs* cfs, cfs_proc_t* u, cfs_proc_t* v) {
+    if (!u->parent) cfs->root = v;
+    else if (u == u->parent->left) u->parent->left = v;
+    else u->parent->right = v;
+    if (v) v->parent = u->parent;
+}
+
+// Take a process out of the tree, if it is queued
+static void dequeue(Cfs* cfs, cfs_proc_t* node) {
+    if (!node->queued) return;
+    node->queued = 0;
+    if (cfs->leftmost == node) cfs->leftmost = next_node(node);
+
+    cfs_proc_t* x;
+    cfs_proc_t* x_parent;
+    int removed_red = node->red;
+    if (!node->left) {
+        x = node->right;
+        x_parent = node->parent;
+        transplant(cfs, node, node->right);
+    } else if (!node->right) {
+        x = node->left;
+        x_parent = node->parent;
+        transplant(cfs, node, node->left);
+    } else {
+        cfs_proc_t* y = node->right;
+        while (y->left) y = y->left;
+        removed_red = y->red;
+        x = y->right;
+        if (y->parent == node) {
+            x_parent = y;
+        } else {
+            x_parent = y->parent;
+            transplant(cfs, y, y->right);
+            y->right = node->right;
+            y->right->parent = y;
+        }
+        transplant(cfs, node, y);
+        y->left = node->left;
+        y->left->parent = y;
+        y->red = node->red;
+    }
+    if (removed_red) return;
+
+    // x carries an extra black; push it up or resolve it with a rotation
+    while (x != cfs->root && !is_red(x)) {
+        if (x == x_parent->left) {
+            cfs_proc_t* w = x_parent->right;
+            if (is_red(w)) {
+                w->red = 0;
+                x_parent->red = 1;
+                rotate_left(cfs, x_parent);
+                w = x_parent->right;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = 1;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (!is_red(w->right)) {
+                    w->left->red = 0;
+                    w->red = 1;
+                    rotate_right(cfs, w);
+                    w = x_parent->right;
+                }
+                w->red = x_parent->red;
+                x_parent->red = 0;
+                w->right->red = 0;
+                rotate_left(cfs, x_parent);
+                x = cfs->root;
+            }
+        } else {
+            cfs_proc_t* w = x_parent->left;
+            if (is_red(w)) {
+                w->red = 0;
+                x_parent->red = 1;
+                rotate_right(cfs, x_parent);
+                w = x_parent->left;
+            }
+            if (!is_red(w->left) && !is_red(w->right)) {
+                w->red = 1;
+                x = x_parent;
+                x_parent = x->parent;
+            } else {
+                if (!is_red(w->left)) {
+                    w->right->red = 0;
+                    w->red = 1;
+                    rotate_left(cfs, w);
+                    w = x_parent->left;
+                }
+                w->red = x_parent->red;
+                x_parent->red = 0;
+                w->left->red = 0;
+                rotate_right(cfs, x_parent);
+                x = cfs->root;
+            }
+        }
+    }
+    if (x) x->red = 0;
+}
+
+// The vruntime sp has had by now, counting the time since it was dispatched
+static unsigned long long vruntime_now(const cfs_proc_t* sp, time_ticks_t now) {
+    return sp->vruntime + (unsigned long long)(now - sp->started) * VRUNTIME_SCALE / sp->weight;
+}
+
+// Add the cpu time sp has had since it was dispatched to its vruntime
+static void charge(cfs_proc_t* sp, time_ticks_t now) {
+    sp->vruntime = vruntime_now(sp, now);
+    sp->started = now;
+}
+
+// The target latency shared among the runnable processes
+static time_ticks_t slice_for(const Cfs* cfs) {
+    time_ticks_t slice = cfs->runnable ? cfs->latency / cfs->runnable : cfs->latency;
+    return slice > cfs->granularity ? slice : cfs->granularity;
+}
+
+// Run the leftmost process on cpu
+static void run_next(sim_t* sim, Cfs* cfs, int cpu) {
+    cfs_proc_t* next = cfs->leftmost;
+    if (!next) return;
+    dequeue(cfs, next);
+    if (next->vruntime > cfs->min_vruntime) cfs->min_vruntime = next->vruntime;
+    next->started = get_current_time(sim);
+    context_switch_on_with_slice(sim, cpu, next->proc->pid, slice_for(cfs));
+}
+
+// The process running on cpu, or NULL if it is idle or the running process's
+// burst has just ended (it is about to block or terminate)
+static cfs_proc_t* running_on(sim_t* sim, Cfs* cfs, int cpu) {
+    pid_t pid = get_current_proc_on(sim, cpu);
+    if (pid < 0 || cfs->procs[pid].proc->state != READY) return NULL;
+    return &cfs->procs[pid];
+}
+
+// A process has become READY: queue it, then run it on an idle cpu, or in
+// place of the running process furthest ahead in vruntime if it is at least
+// the minimum granularity ahead of this one
+static void make_ready(sim_t* sim, Cfs* cfs, cfs_proc_t* sp) {
+    if (sp->vruntime < cfs->min_vruntime) sp->vruntime = cfs->min_vruntime;
+    sp->runnable = 1;
+    ++cfs->runnable;
+    enqueue(cfs, sp);
+
+    time_ticks_t now = get_current_time(sim);
+    unsigned int num_cpus = get_num_cpus(sim);
+    int victim = -1;
+    unsigned long long victim_vruntime = 0;
+    for (unsigned int cpu = 0; cpu < num_cpus; ++cpu) {
+        cfs_proc_t* running = running_on(sim, cfs, cpu);
+        if (!running) {
+            run_next(sim, cfs, cpu);
+            return;
+        }
+        unsigned long long vruntime = vruntime_now(running, now);
+        if (victim < 0 || vruntime > victim_vruntime) {
+            victim = cpu;
+            victim_vruntime = vruntime;
+        }
+    }
+    unsigned long long granularity = (unsigned long long)cfs->granularity * VRUNTIME_SCALE / sp->weight;
+    if (victim < 0 || sp->vruntime + granularity >= victim_vruntime) return;
+    cfs_proc_t* preempted = running_on(sim, cfs, victim);
+    charge(preempted, now);
+    enqueue(cfs, preempted);
+    run_next(sim, cfs, victim);
+}
+
+// The cpu proc was running on, if nothing else has been given it since
+static int freed_cpu(sim_t* sim, const struct process* proc) {
+    int cpu = get_proc_cpu(sim, proc->pid);
+    if (cpu < 0) return -1;
+    pid_t current = get_current_proc_on(sim, cpu);
+    return (current < 0 || current == proc->pid) ? cpu : -1;
+}
+
+// A running process has stopped being runnable
+static void make_idle(sim_t* sim, Cfs* cfs, const struct process* proc) {
+    cfs_proc_t* sp = &cfs->procs[proc->pid];
+    dequeue(cfs, sp);
+    if (sp->runnable) {
+        charge(sp, get_current_time(sim));
+        sp->runnable = 0;
+        --cfs->runnable;
+    }
+    int cpu = freed_cpu(sim, proc);
+    if (cpu >= 0) run_next(sim, cfs, cpu);
+}
+
+static void sched_init(sim_t* sim) {
+    use_time_slice(sim, TRUE);
+    Cfs* cfs = malloc(sizeof(Cfs));
+    assert(cfs);
+    time_ticks_t slice = get_time_slice(sim) ? get_time_slice(sim) : 1;
+    cfs->latency = slice * CFS_LATENCY_SLICES;
+    cfs->granularity = slice / CFS_GRANULARITY_DIVISOR ? slice / CFS_GRANULARITY_DIVISOR : 1;
+    cfs->root = cfs->leftmost = NULL;
+    cfs->num_procs = get_num_procs(sim);
+    cfs->procs = calloc(cfs->num_procs + 1, sizeof(cfs_proc_t));
+    assert(cfs->procs);
+    cfs->runnable = 0;
+    cfs->next_seq = 0;
+    cfs->min_vruntime = 0;
+    set_sched_data(sim, cfs);
+}
+
+static void sched_new_process(sim_t* sim, const struct process* proc) {
+    Cfs* cfs = get_sched_data(sim);
+    assert(READY == proc->state);
+    cfs_proc_t* sp = &cfs->procs[proc->pid];
+    sp->proc = proc;
+    sp->weight = proc->tickets ? proc->tickets : 1;
+    sp->vruntime = cfs->min_vruntime;
+    make_ready(sim, cfs, sp);
+}
+
+// Keep running unless some waiting process has had no more vruntime
+static void sched_finished_time_slice(sim_t* sim, const struct process* proc) {
+    Cfs* cfs = get_sched_data(sim);
+    cfs_proc_t* sp = &cfs->procs[proc->pid];
+    charge(sp, get_current_time(sim));
+    if (cfs->leftmost && cfs->leftmost->vruntime <= sp->vruntime) {
+        enqueue(cfs, sp);
+        run_next(sim, cfs, get_proc_cpu(sim, proc->pid));
+    } else {
+        rearm_time_slice(sim, get_proc_cpu(sim, proc->pid), slice_for(cfs));
+    }
+}
+
+static void sched_blocked(sim_t* sim, const struct process* proc) {
+    assert(BLOCKED == proc->state);
+    make_idle(sim, get_sched_data(sim), proc);
+}
+
+static void sched_unblocked(sim_t* sim, const struct process* proc) {
+    Cfs* cfs = get_sched_data(sim);
+    assert(READY == proc->state);
+    make_ready(sim, cfs, &cfs->procs[proc->pid]);
+}
+
+static void sched_terminated(sim_t* sim, const struct process* proc) {
+    assert(TERMINATED == proc->state);
+    make_idle(sim, get_sched_data(sim), proc);
+}
+
+static void sched_free(void* data) {
+    Cfs* cfs = data;
+    free(cfs->procs);
+    free(cfs);
+}
+
+static void sched_cleanup(sim_t* sim) {
+    sched_free(get_sched_data(sim));
+    set_sched_data(sim, NULL);
+}
+
+// Point a tree link at the same slot of the copy's table
+static cfs_proc_t* relink(const Cfs* cfs, Cfs* copy, const cfs_proc_t* node) {
+    return node ? &copy->procs[node - cfs->procs] : NULL;
+}
+
+// Copy the table; the tree lives inside it, so every link is moved across
+static void* sched_clone(const void* data) {
+    const Cfs* cfs = data;
+    Cfs* copy = malloc(sizeof(Cfs));
+    assert(copy);
+    *copy = *cfs;
+    copy->procs = malloc((cfs->num_procs + 1) * sizeof(cfs_proc_t));
+    assert(copy->procs);
+    memcpy(copy->procs, cfs->procs, (cfs->num_procs + 1) * sizeof(cfs_proc_t));
+    for (unsigned int pid = 0; pid < cfs->num_procs; ++pid) {
+        cfs_proc_t* sp = &copy->procs[pid];
+        sp->parent = relink(cfs, copy, sp->parent);
+        sp->left = relink(cfs, copy, sp->left);
+        sp->right = relink(cfs, copy, sp->right);
+    }
+    copy->root = relink(cfs, copy, cfs->root);
+    copy->leftmost = relink(cfs, copy, cfs->leftmost);
+    return copy;
+}
+
+
+const struct sched_policy cfs_policy = {
+    "cfs",
+    sched_init,
+    sched_new_process,
+    sched_finished_time_slice,
+    sched_blocked,
+    sched_unblocked,
+    sched_terminated,
+    sched_cleanup,
+    sched_clone,
+    sched_free,
+    NULL,
+    NULL,
+};
@@ -0,0 +1,191 @@
+#include "scheduler.h"
+#include "rng.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+// Lottery scheduling: whenever a cpu needs a process, every READY process that
+// is not running holds its tickets in a draw and a random ticket picks the
+// winner, so over time each process gets cpu in proportion to its tickets.
+//
+// The tickets in the draw are kept in a Fenwick tree indexed by pid, so adding
+// a process, removing one and drawing a winner are all O(log n).  All cpus
+// draw from the one pool, so there is nothing to steal.
+
+// the state of one simulation
+typedef struct {
+    unsigned long* tree;     // Fenwick tree of queued tickets; tree[i] covers pids i-lowbit(i) .. i-1
+    unsigned int* tickets;   // tickets pid holds in the draw, 0 while it is not queued
+    unsigned int size;       // number of pids
+    unsigned int top_bit;    // highest power of two <= size
+    unsigned long total;     // tickets in the draw
+    struct rng rng;
+} Lottery;
+
+// Every process takes part with at least one ticket
+static unsigned int tickets_of(const struct process* proc) {
+    return proc->tickets ? proc->tickets : 1;
+}
+
+static void tree_add(Lottery* lottery, pid_t pid, long delta) {
+    for (unsigned int i = pid + 1; i <= lottery->size; i += i & -i) {
+        lottery->tree[i] += delta;
+    }
+    lottery->total += delta;
+}
+
+// Find the pid holding ticket number 'ticket' (0 <= ticket < total): the
+// smallest pid whose tickets plus those of every lower pid exceed it
+static pid_t tree_find(const Lottery* lottery, unsigned long ticket) {
+    unsigned int i = 0;
+    for (unsigned int bit = lottery->top_bit; bit > 0; bit >>= 1) {
+        if (i + bit <= lottery->size && lottery->tree[i + bit] <= ticket) {
+            i += bit;
+            ticket -= lottery->tree[i];
+        }
+    }
+    return i; // tree index i + 1, which is pid i
+}
+
+// Put a process into the draw
+static void enqueue(Lottery* lottery, const struct process* proc) {
+    assert(proc->pid >= 0 && (unsigned int)proc->pid < lottery->size);
+    if (lottery->tickets[proc->pid]) return;
+    lottery->tickets[proc->pid] = tickets_of(proc);
+    tree_add(lottery, proc->pid, lottery->tickets[proc->pid]);
+}
+
+// Take a process out of the draw
+static void dequeue(Lottery* lottery, pid_t pid) {
+    if (pid < 0 || (unsigned int)pid >= lottery->size || !lottery->tickets[pid]) return;
+    tree_add(lottery, pid, -(long)lottery->tickets[pid]);
+    lottery->tickets[pid] = 0;
+}
+
+// Draw a winner for cpu and run it there, unless it is already running there
+static void schedule_next(sim_t* sim, Lottery* lottery, int cpu) {
+    if (lottery->total == 0) return;
+    pid_t winner = tree_find(lottery, rng_below(&lottery->rng, lottery->total));
+    dequeue(lottery, winner);
+    if (winner != get_current_proc_on(sim, cpu)) {
+        context_switch_on(sim, cpu, winner);
+    }
+}
+
+// Hold a draw for every idle cpu, while there is anyone to draw
+static void schedule_idle(sim_t* sim, Lottery* lottery) {
+    unsigned int num_cpus = get_num_cpus(sim);
+    for (unsigned int cpu = 0; cpu < num_cpus && lottery->total > 0; ++cpu) {
+        if (get_current_proc_on(sim, cpu) == -1) {
+            schedule_next(sim, lottery, cpu);
+        }
+    }
+}
+
+// Hold a draw for the cpu proc has just stopped running on.  By the time its
+// event is handled that cpu may already have gone idle and been given another
+// process (its burst ended while an earlier event was handled), or proc may
+// be ending an I/O burst; either way a cpu running someone else is left alone.
+static void schedule_freed(sim_t* sim, Lottery* lottery, const struct process* proc) {
+    int cpu = get_proc_cpu(sim, proc->pid);
+    if (cpu < 0) return;
+    pid_t current = get_current_proc_on(sim, cpu);
+    if (current == -1 || current == proc->pid) {
+        schedule_next(sim, lottery, cpu);
+    }
+}
+
+static void sched_init(sim_t* sim) {
+    use_time_slice(sim, TRUE);
+    Lottery* lottery = malloc(sizeof(Lottery));
+    assert(lottery);
+    lottery->size = get_num_procs(sim);
+    lottery->tree = calloc(lottery->size + 1, sizeof(unsigned long));
+    lottery->tickets = calloc(lottery->size + 1, sizeof(unsigned int));
+    assert(lottery->tree && lottery->tickets);
+    lottery->top_bit = 1;
+    while (lottery->top_bit * 2 <= lottery->size) {
+        lottery->top_bit *= 2;
+    }
+    lottery->total = 0;
+    rng_seed(&lottery->rng, get_seed(sim), 0);
+    set_sched_data(sim, lottery);
+}
+
+static void sched_new_process(sim_t* sim, const struct process* proc) {
+    Lottery* lottery = get_sched_data(sim);
+    assert(READY == proc->state);
+    enqueue(lottery, proc);
+    schedule_idle(sim, lottery);
+}
+
+// The process whose slice ended goes back into the draw held for its cpu
+static void sched_finished_time_slice(sim_t* sim, const struct process* proc) {
+    Lottery* lottery = get_sched_data(sim);
+    assert(READY == proc->state);
+    enqueue(lottery, proc);
+    schedule_next(sim, lottery, get_proc_cpu(sim, proc->pid));
+}
+
+static void sched_blocked(sim_t* sim, const struct process* proc) {
+    Lottery* lottery = get_sched_data(sim);
+    assert(BLOCKED == proc->state);
+    schedule_freed(sim, lottery, proc);
+}
+
+static void sched_unblocked(sim_t* sim, const struct process* proc) {
+    Lottery* lottery = get_sched_data(sim);
+    assert(READY == proc->state);
+    enqueue(lottery, proc);
+    schedule_idle(sim, lottery);
+}
+
+static void sched_terminated(sim_t* sim, const struct process* proc) {
+    Lottery* lottery = get_sched_data(sim);
+    assert(TERMINATED == proc->state);
+    dequeue(lottery, proc->pid);
+    schedule_freed(sim, lottery, proc);
+}
+
+static void sched_free(void* data) {
+    Lottery* lottery = data;
+    free(lottery->tree);
+    free(lottery->tickets);
+    free(lottery);
+}
+
+static void sched_cleanup(sim_t* sim) {
+    sched_free(get_sched_data(sim));
+    set_sched_data(sim, NULL);
+}
+
+// Copy the tree, the tickets and the generator, so a restored run draws the
+// same winners as the original
+static void* sched_clone(const void* data) {
+    const Lottery* lottery = data;
+    Lottery* copy = malloc(sizeof(Lottery));
+    assert(copy);
+    *copy = *lottery;
+    copy->tree = malloc((lottery->size + 1) * sizeof(unsigned long));
+    copy->tickets = malloc((lottery->size + 1) * sizeof(unsigned int));
+    assert(copy->tree && copy->tickets);
+    memcpy(copy->tree, lottery->tree, (lottery->size + 1) * sizeof(unsigned long));
+    memcpy(copy->tickets, lottery->tickets, (lottery->size + 1) * sizeof(unsigned int));
+    return copy;
+}
+
+
+const struct sched_policy lottery_policy = {
+    "lottery",
+    sched_init,
+    sched_new_process,
+    sched_finished_time_slice,
+    sched_blocked,
+    sched_unblocked,
+    sched_terminated,
+    sched_cleanup,
+    sched_clone,
+    sched_free,
+    NULL,
+    NULL,
+};
@@ -0,0 +1,274 @@
+#include "scheduler.h"
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+
+// Multi-level feedback queue: a process starts at the top level (0) and drops
+// a level each time it uses up a whole time slice, so processes that block
+// early stay on top while cpu-bound ones sink.  Each level gets a longer slice
+// than the one above it.  Every boost period all processes go back to the top
+// level, so nothing that sank starves.
+//
+// Every cpu runs the highest process it can; a process arriving or unblocking
+// above the lowest running level preempts it.  The levels, their slices and
+// the boost period can be set at build time, e.g. -DMLFQ_LEVELS=4.
+
+#ifndef MLFQ_LEVELS
+#define MLFQ_LEVELS 3          // at most 32
+#endif
+#ifndef MLFQ_SLICE_GROWTH
+#define MLFQ_SLICE_GROWTH 2    // each level's slice is this times the level above's
+#endif
+#ifndef MLFQ_BOOST_SLICES
+#define MLFQ_BOOST_SLICES 20   // boost period, in top-level time slices
+#endif
+
+_Static_assert(MLFQ_LEVELS >= 1 && MLFQ_LEVELS <= 32, "MLFQ_LEVELS must fit the nonempty bitmap");
+
+#define NO_PID (-1)
+
+typedef struct {
+    const struct process* proc;
+    int level;
+    pid_t next;       // in its level's queue, while queued
+    pid_t prev;
+    int queued;
+} mlfq_proc_t;
+
+typedef struct {
+    pid_t head;
+    pid_t tail;
+} mlfq_level_t;
+
+// the state of one simulation
+typedef struct {
+    mlfq_level_t levels[MLFQ_LEVELS];
+    unsigned int nonempty;            // bit l is set while level l has a queued process
+    time_ticks_t slices[MLFQ_LEVELS]; // time slice of each level
+    time_ticks_t boost_period;
+    mlfq_proc_t* procs;               // indexed by pid
+    unsigned int num_procs;
+    unsigned int live;                // processes that have arrived and not terminated
+    int timer_set;                    // a boost is pending
+} Mlfq;
+
+// Queue a process at the back of its level
+static void push_back(Mlfq* mlfq, pid_t pid) {
+    mlfq_proc_t* mp = &mlfq->procs[pid];
+    mlfq_level_t* level = &mlfq->levels[mp->level];
+    assert(!mp->queued);
+    mp->queued = 1;
+    mp->next = NO_PID;
+    mp->prev = level->tail;
+    if (level->tail == NO_PID) {
+        level->head = pid;
+        mlfq->nonempty |= 1u << mp->level;
+    } else {
+        mlfq->procs[level->tail].next = pid;
+    }
+    level->tail = pid;
+}
+
+// Take a process out of its level's queue, if it is queued
+static void unlink_proc(Mlfq* mlfq, pid_t pid) {
+    mlfq_proc_t* mp = &mlfq->procs[pid];
+    if (!mp->queued) return;
+    mlfq_level_t* level = &mlfq->levels[mp->level];
+    if (mp->prev == NO_PID) level->head = mp->next; else mlfq->procs[mp->prev].next = mp->next;
+    if (mp->next == NO_PID) level->tail = mp->prev; else mlfq->procs[mp->next].prev = mp->prev;
+    if (level->head == NO_PID) mlfq->nonempty &= ~(1u << mp->level);
+    mp->queued = 0;
+}
+
+// The highest queued level, or MLFQ_LEVELS if nothing is queued
+static int top_level(const Mlfq* mlfq) {
+    return mlfq->nonempty ? __builtin_ctz(mlfq->nonempty) : MLFQ_LEVELS;
+}
+
+// Run the process at the head of the highest level on cpu
+static void run_next(sim_t* sim, Mlfq* mlfq, int cpu) {
+    int level = top_level(mlfq);
+    if (level == MLFQ_LEVELS) return;
+    pid_t pid = mlfq->levels[level].head;
+    unlink_proc(mlfq, pid);
+    context_switch_on_with_slice(sim, cpu, pid, mlfq->slices[level]);
+}
+
+// The level of the process running on cpu; MLFQ_LEVELS if it is idle or
+// its burst has just ended (it is about to block or terminate)
+static int running_level(sim_t* sim, Mlfq* mlfq, int cpu) {
+    pid_t pid = get_current_proc_on(sim, cpu);
+    if (pid == NO_PID || mlfq->procs[pid].proc->state != READY) return MLFQ_LEVELS;
+    return mlfq->procs[pid].level;
+}
+
+// A process has become READY: run it on an idle cpu, or in place of the
+// lowest running process if that is below it
+static void make_ready(sim_t* sim, Mlfq* mlfq, pid_t pid) {
+    push_back(mlfq, pid);
+    unsigned int num_cpus = get_num_cpus(sim);
+    int victim = -1;
+    int victim_level = mlfq->procs[pid].level;
+    for (unsigned int cpu = 0; cpu < num_cpus; ++cpu) {
+        int level = running_level(sim, mlfq, cpu);
+        if (level > victim_level) {
+            victim = cpu;
+            victim_level = level;
+        }
+    }
+    if (victim < 0) return;
+    pid_t preempted = get_current_proc_on(sim, victim);
+    run_next(sim, mlfq, victim);
+    if (preempted != NO_PID && mlfq->procs[preempted].proc->state == READY) push_back(mlfq, preempted);
+}
+
+// Every process goes back to the top level: the queues are appended to level
+// 0 in order and running processes move up in place
+static void sched_timer(sim_t* sim) {
+    Mlfq* mlfq = get_sched_data(sim);
+    mlfq->timer_set = 0;
+    mlfq_level_t* top = &mlfq->levels[0];
+    for (int l = 1; l < MLFQ_LEVELS; ++l) {
+        mlfq_level_t* level = &mlfq->levels[l];
+        for (pid_t pid = level->head; pid != NO_PID; pid = mlfq->procs[pid].next) {
+            mlfq->procs[pid].level = 0;
+        }
+        if (level->head == NO_PID) continue;
+        if (top->tail == NO_PID) {
+            top->head = level->head;
+        } else {
+            mlfq->procs[top->tail].next = level->head;
+            mlfq->procs[level->head].prev = top->tail;
+        }
+        top->tail = level->tail;
+        level->head = level->tail = NO_PID;
+    }
+    if (top->head != NO_PID) mlfq->nonempty = 1;
+
+    unsigned int num_cpus = get_num_cpus(sim);
+    for (unsigned int cpu = 0; cpu < num_cpus; ++cpu) {
+        pid_t pid = get_current_proc_on(sim, cpu);
+        if (pid != NO_PID) mlfq->procs[pid].level = 0;
+    }
+    if (mlfq->live > 0) {
+        set_timer(sim, mlfq->boost_period);
+        mlfq->timer_set = 1;
+    }
+}
+
+// The cpu proc was running on, if nothing else has been given it since
+static int freed_cpu(sim_t* sim, const struct process* proc) {
+    int cpu = get_proc_cpu(sim, proc->pid);
+    if (cpu < 0) return -1;
+    pid_t current = get_current_proc_on(sim, cpu);
+    return (current == NO_PID || current == proc->pid) ? cpu : -1;
+}
+
+static void sched_init(sim_t* sim) {
+    use_time_slice(sim, TRUE);
+    Mlfq* mlfq = malloc(sizeof(Mlfq));
+    assert(mlfq);
+    time_ticks_t slice = get_time_slice(sim) ? get_time_slice(sim) : 1;
+    for (int l = 0; l < MLFQ_LEVELS; ++l) {
+        mlfq->levels[l].head = mlfq->levels[l].tail = NO_PID;
+        mlfq->slices[l] = slice;
+        slice *= MLFQ_SLICE_GROWTH;
+    }
+    mlfq->nonempty = 0;
+    mlfq->boost_period = mlfq->slices[0] * MLFQ_BOOST_SLICES;
+    mlfq->num_procs = get_num_procs(sim);
+    mlfq->procs = calloc(mlfq->num_procs + 1, sizeof(mlfq_proc_t));
+    assert(mlfq->procs);
+    mlfq->live = 0;
+    mlfq->timer_set = 0;
+    set_sched_data(sim, mlfq);
+}
+
+static void sched_new_process(sim_t* sim, const struct process* proc) {
+    Mlfq* mlfq = get_sched_data(sim);
+    assert(READY == proc->state);
+    mlfq_proc_t* mp = &mlfq->procs[proc->pid];
+    mp->proc = proc;
+    mp->level = 0;
+    mp->queued = 0;
+    ++mlfq->live;
+    if (!mlfq->timer_set) {
+        set_timer(sim, mlfq->boost_period);
+        mlfq->timer_set = 1;
+    }
+    make_ready(sim, mlfq, proc->pid);
+}
+
+// The process used its whole slice: it drops a level and goes behind the
+// others there, unless it is still the highest process waiting
+static void sched_finished_time_slice(sim_t* sim, const struct process* proc) {
+    Mlfq* mlfq = get_sched_data(sim);
+    mlfq_proc_t* mp = &mlfq->procs[proc->pid];
+    if (mp->level + 1 < MLFQ_LEVELS) ++mp->level;
+    if (top_level(mlfq) <= mp->level) {
+        push_back(mlfq, proc->pid);
+        run_next(sim, mlfq, get_proc_cpu(sim, proc->pid));
+    } else {
+        rearm_time_slice(sim, get_proc_cpu(sim, proc->pid), mlfq->slices[mp->level]); // keeps running at its new level
+    }
+}
+
+static void sched_blocked(sim_t* sim, const struct process* proc) {
+    Mlfq* mlfq = get_sched_data(sim);
+    assert(BLOCKED == proc->state);
+    int cpu = freed_cpu(sim, proc);
+    if (cpu >= 0) run_next(sim, mlfq, cpu);
+}
+
+static void sched_unblocked(sim_t* sim, const struct process* proc) {
+    Mlfq* mlfq = get_sched_data(sim);
+    assert(READY == proc->state);
+    make_ready(sim, mlfq, proc->pid);
+}
+
+static void sched_terminated(sim_t* sim, const struct process* proc) {
+    Mlfq* mlfq = get_sched_data(sim);
+    assert(TERMINATED == proc->state);
+    unlink_proc(mlfq, proc->pid);
+    --mlfq->live;
+    int cpu = freed_cpu(sim, proc);
+    if (cpu >= 0) run_next(sim, mlfq, cpu);
+}
+
+static void sched_free(void* data) {
+    Mlfq* mlfq = data;
+    free(mlfq->procs);
+    free(mlfq);
+}
+
+static void sched_cleanup(sim_t* sim) {
+    sched_free(get_sched_data(sim));
+    set_sched_data(sim, NULL);
+}
+
+static void* sched_clone(const void* data) {
+    const Mlfq* mlfq = data;
+    Mlfq* copy = malloc(sizeof(Mlfq));
+    assert(copy);
+    *copy = *mlfq;
+    copy->procs = malloc((mlfq->num_procs + 1) * sizeof(mlfq_proc_t));
+    assert(copy->procs);
+    memcpy(copy->procs, mlfq->procs, (mlfq->num_procs + 1) * sizeof(mlfq_proc_t));
+    return copy;
+}
+
+
+const struct sched_policy mlfq_policy = {
+    "mlfq",
+    sched_init,
+    sched_new_process,
+    sched_finished_time_slice,
+    sched_blocked,
+    sched_unblocked,
+    sched_terminated,
+    sched_cleanup,
+    sched_clone,
+    sched_free,
+    sched_timer,
+    NULL,
+};
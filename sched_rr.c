@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 
 typedef struct {
@@ -12,9 +13,13 @@ typedef struct {
   int capacity;
 } Queue;
 
-static Queue *queue = NULL;
+// the state of one simulation: a run queue per cpu, whose head is running
+typedef struct {
+  Queue **queues;
+  unsigned int num_queues;
+} RoundRobin;
 
-Queue *createQueue() {
+static Queue *createQueue() {
   Queue *queue = (Queue *)malloc(sizeof(Queue));
   queue->capacity = 10;
   queue->front = 0;
@@ -25,19 +30,19 @@ Queue *createQueue() {
   return queue;
 }
 
-int isFull() {
+static int isFull(Queue *queue) {
   return (queue->size == queue->capacity);
 }
 
-int isEmpty() {
+static int isEmpty(Queue *queue) {
   return (queue->size == 0);
 }
 
-int hasOne() {
+static int hasOne(Queue *queue) {
   return (queue->size == 1);
 }
 
-void resizeQueue() {
+static void resizeQueue(Queue *queue) {
   int newCapacity = queue->capacity * 2;
   const struct process **newArray = (const struct process **)malloc(newCapacity * sizeof(const struct process *));
 
@@ -53,7 +58,7 @@ void resizeQueue() {
   queue->capacity = newCapacity;
 }
 
-void push(const struct process* item)
+static void push(Queue *queue, const struct process* item)
 {
   if (isFull(queue))
   {
@@ -64,22 +69,75 @@ void push(const struct process* item)
   queue->size++;
 }
 
-const struct process* first() {
+static const struct process* first(Queue *queue) {
   return queue->array[queue->front];
 }
 
-const struct process* pop() {
+static const struct process* pop(Queue *queue) {
   const struct process *item = queue->array[queue->front];
   queue->front = (queue->front + 1) % queue->capacity;
   queue->size--;
   return item;
 }
 
-void freeQueue() {
+static const struct process* popRear(Queue *queue) {
+  const struct process *item = queue->array[queue->rear];
+  queue->rear = (queue->rear + queue->capacity - 1) % queue->capacity;
+  queue->size--;
+  return item;
+}
+
+static void freeQueue(Queue *queue) {
   free(queue->array);
   free(queue);
 }
 
+static Queue *copyQueue(const Queue *queue) {
+  Queue *copy = (Queue *)malloc(sizeof(Queue));
+  *copy = *queue;
+  copy->array = (const struct process **)malloc(queue->capacity * sizeof(const struct process *));
+  memcpy(copy->array, queue->array, queue->capacity * sizeof(const struct process *));
+  return copy;
+}
+
+/* leastLoaded
+ *   returns the cpu with the shortest run queue (the lowest cpu wins ties)
+ */
+static int leastLoaded(RoundRobin *rr) {
+  int best = 0;
+  for (unsigned int cpu = 1; cpu < rr->num_queues; cpu++)
+  {
+    if (rr->queues[cpu]->size < rr->queues[best]->size)
+      best = cpu;
+  }
+  return best;
+}
+
+/* steal
+ *   called when cpu's run queue has just emptied: takes the process at the
+ *   rear of the longest other queue (the one that would wait there longest)
+ *   and runs it on cpu.  The head of a queue is running, so only queues
+ *   with someone waiting behind it are candidates.
+ */
+static void steal(sim_t* sim, RoundRobin *rr, int cpu) {
+  if (!get_work_stealing(sim))
+    return;
+  int victim = -1;
+  for (unsigned int other = 0; other < rr->num_queues; other++)
+  {
+    if ((int)other != cpu && rr->queues[other]->size > 1
+        && (victim < 0 || rr->queues[other]->size > rr->queues[victim]->size))
+      victim = other;
+  }
+  if (victim < 0)
+    return;
+
+  const struct process *proc = popRear(rr->queues[victim]);
+  push(rr->queues[cpu], proc);
+  record_steal(sim, proc->pid, victim, cpu);
+  context_switch_on(sim, cpu, proc->pid);
+}
+
 /*************************
  * ROUND ROBIN Scheduler *
  *************************/
@@ -87,9 +145,16 @@ void freeQueue() {
 /* sched_init
  *   will be called exactly once before any processes arrive or any other events
  */
-void sched_init() {
-  use_time_slice(TRUE);
-  queue = createQueue();
+static void sched_init(sim_t* sim) {
+  use_time_slice(sim, TRUE);
+  RoundRobin *rr = (RoundRobin *)malloc(sizeof(RoundRobin));
+  rr->num_queues = get_num_cpus(sim);
+  rr->queues = (Queue **)malloc(rr->num_queues * sizeof(Queue *));
+  for (unsigned int cpu = 0; cpu < rr->num_queues; cpu++)
+  {
+    rr->queues[cpu] = createQueue();
+  }
+  set_sched_data(sim, rr);
 }
 
 
@@ -98,13 +163,15 @@ void sched_init() {
  *
  * proc - the new process that just arrived
  */
-void sched_new_process(const struct process* proc) {
+static void sched_new_process(sim_t* sim, const struct process* proc) {
+  RoundRobin *rr = get_sched_data(sim);
   assert(READY == proc->state);
   // printf("in sched_new_process\n");
-  push(proc);
-  if (hasOne())
+  int cpu = leastLoaded(rr);
+  push(rr->queues[cpu], proc);
+  if (hasOne(rr->queues[cpu]))
   {
-    context_switch(proc->pid);
+    context_switch_on(sim, cpu, proc->pid);
   }
 }
 
@@ -120,15 +187,18 @@ void sched_new_process(const struct process* proc) {
  *
  * Note: Time slice end events only occur if use_time_slice() is set to TRUE
  */
-void sched_finished_time_slice(const struct process* proc) {
+static void sched_finished_time_slice(sim_t* sim, const struct process* proc) {
+  RoundRobin *rr = get_sched_data(sim);
   assert(READY == proc->state);
   // printf("in sched_finished_time_slice\n");
-  pop();
-  push(proc);
-  if (!isEmpty() && !hasOne())
+  int cpu = get_proc_cpu(sim, proc->pid);
+  Queue *queue = rr->queues[cpu];
+  pop(queue);
+  push(queue, proc);
+  if (!isEmpty(queue) && !hasOne(queue))
   {
-    const struct process *next_proc = first();
-    context_switch(next_proc->pid);
+    const struct process *next_proc = first(queue);
+    context_switch_on(sim, cpu, next_proc->pid);
   }
 }
 
@@ -139,15 +209,22 @@ void sched_finished_time_slice(const struct process* proc) {
  *
  * proc - the process that just blocked
  */
-void sched_blocked(const struct process* proc) {
+static void sched_blocked(sim_t* sim, const struct process* proc) {
+  RoundRobin *rr = get_sched_data(sim);
   assert(BLOCKED == proc->state);
 
   // printf("in sched_blocked\n");
-  pop();
-  if (!isEmpty())
+  int cpu = get_proc_cpu(sim, proc->pid);
+  Queue *queue = rr->queues[cpu];
+  pop(queue);
+  if (!isEmpty(queue))
+  {
+    const struct process *next_proc = first(queue);
+    context_switch_on(sim, cpu, next_proc->pid);
+  }
+  else
   {
-    const struct process *next_proc = first();
-    context_switch(next_proc->pid);
+    steal(sim, rr, cpu);
   }
 }
 
@@ -158,13 +235,15 @@ void sched_blocked(const struct process* proc) {
  *
  * proc - the process that just unblocked
  */
-void sched_unblocked(const struct process* proc) {
+static void sched_unblocked(sim_t* sim, const struct process* proc) {
+  RoundRobin *rr = get_sched_data(sim);
   // printf("in sched_unblocked\n");
   assert(READY == proc->state);
-  push(proc);
-  if (hasOne())
+  int cpu = leastLoaded(rr);
+  push(rr->queues[cpu], proc);
+  if (hasOne(rr->queues[cpu]))
   {
-    context_switch(proc->pid);
+    context_switch_on(sim, cpu, proc->pid);
   }
 }
 
@@ -179,18 +258,39 @@ void sched_unblocked(const struct process* proc) {
  *       currently running are not being simulated, so only the currently running
  *       process can actually terminate.
  */
-void sched_terminated(const struct process* proc) {
+static void sched_terminated(sim_t* sim, const struct process* proc) {
+  RoundRobin *rr = get_sched_data(sim);
   // printf("in sched_terminated\n");
   assert(TERMINATED == proc->state);
-  pop();
-  if (!isEmpty())
+  int cpu = get_proc_cpu(sim, proc->pid);
+  Queue *queue = rr->queues[cpu];
+  pop(queue);
+  if (!isEmpty(queue))
+  {
+    const struct process *next_proc = first(queue);
+    context_switch_on(sim, cpu, next_proc->pid);
+  }
+  else
   {
-    const struct process *next_proc = first();
-    context_switch(next_proc->pid);
+    steal(sim, rr, cpu);
   }
 }
 
 
+/* sched_free
+ *   frees the run queues of a run or of a snapshot's copy
+ */
+static void sched_free(void* data) {
+  RoundRobin *rr = data;
+  for (unsigned int cpu = 0; cpu < rr->num_queues; cpu++)
+  {
+    freeQueue(rr->queues[cpu]);
+  }
+  free(rr->queues);
+  free(rr);
+}
+
+
 /* sched_cleanup
  *   will be called exactly once after all processes have terminated and there
  *   are no more events left to occur, just before the simulation exits
@@ -199,6 +299,49 @@ void sched_terminated(const struct process* proc) {
  *       but is not guaranteed in the case of fatal errors, crashes, or other
  *       abnormal exits.
  */
-void sched_cleanup() {
-  freeQueue(); 
+static void sched_cleanup(sim_t* sim) {
+  sched_free(get_sched_data(sim));
+  set_sched_data(sim, NULL);
 }
+
+
+/* sched_clone
+ *   copies the run queues for a snapshot; they hold process pointers only
+ */
+static void* sched_clone(const void* data) {
+  const RoundRobin *rr = data;
+  RoundRobin *copy = (RoundRobin *)malloc(sizeof(RoundRobin));
+  copy->num_queues = rr->num_queues;
+  copy->queues = (Queue **)malloc(rr->num_queues * sizeof(Queue *));
+  for (unsigned int cpu = 0; cpu < rr->num_queues; cpu++)
+  {
+    copy->queues[cpu] = copyQueue(rr->queues[cpu]);
+  }
+  return copy;
+}
+
+
+/* sched_queue_length
+ *   returns how many processes wait behind the one running in cpu's run queue
+ */
+static unsigned int sched_queue_length(sim_t* sim, int cpu) {
+  RoundRobin *rr = get_sched_data(sim);
+  int waiting = rr->queues[cpu]->size - (-1 != get_current_proc_on(sim, cpu));
+  return (waiting > 0) ? waiting : 0;
+}
+
+
+const struct sched_policy rr_policy = {
+  "rr",
+  sched_init,
+  sched_new_process,
+  sched_finished_time_slice,
+  sched_blocked,
+  sched_unblocked,
+  sched_terminated,
+  sched_cleanup,
+  sched_clone,
+  sched_free,
+  NULL,
+  sched_queue_length,
+};
@@ -3,21 +3,34 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
+// A binary min-heap of ready processes keyed on remaining time in the
+// current CPU burst.  Every queued process also records its heap slot in
+// heap_pos (indexed by pid), so removing an arbitrary process is O(log n)
+// instead of a scan.
 typedef struct {
     const struct process **array;
     int size;
     int capacity;
+    int *heap_pos;  // shared by every cpu's queue; a pid is queued on at most one
 } PriorityQueue;
 
-static PriorityQueue *ready_queue = NULL;
-static const struct process *current_proc = NULL;
+// the state of one simulation: a ready queue and running-process tracker per cpu
+typedef struct {
+    PriorityQueue **ready_queues;
+    const struct process **current_procs;
+    unsigned int num_queues;
+    int *heap_pos;  // heap slot of every queued pid, or -1
+    unsigned int num_procs;  // entries in heap_pos
+} Stcf;
 
-static PriorityQueue *create_queue() {
+static PriorityQueue *create_queue(int *heap_pos) {
     PriorityQueue *q = malloc(sizeof(PriorityQueue));
     assert(q);
     q->capacity = 10;
     q->size = 0;
+    q->heap_pos = heap_pos;
     q->array = malloc(q->capacity * sizeof(const struct process *));
     assert(q->array);
     return q;
@@ -29,19 +42,51 @@ static void resize_queue(PriorityQueue *q) {
     assert(q->array);
 }
 
+// Shorter remaining time first; equal times go to the lower pid
+static int runs_before(const struct process *a, const struct process *b) {
+    if (proc_remaining_time(a) != proc_remaining_time(b))
+        return proc_remaining_time(a) < proc_remaining_time(b);
+    return a->pid < b->pid;
+}
+
+static void place(PriorityQueue *q, int i, const struct process *proc) {
+    q->array[i] = proc;
+    q->heap_pos[proc->pid] = i;
+}
+
+static void sift_up(PriorityQueue *q, int i) {
+    const struct process *proc = q->array[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!runs_before(proc, q->array[parent])) break;
+        place(q, i, q->array[parent]);
+        i = parent;
+    }
+    place(q, i, proc);
+}
+
+static void sift_down(PriorityQueue *q, int i) {
+    const struct process *proc = q->array[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= q->size) break;
+        if (child + 1 < q->size && runs_before(q->array[child + 1], q->array[child])) child++;
+        if (!runs_before(q->array[child], proc)) break;
+        place(q, i, q->array[child]);
+        i = child;
+    }
+    place(q, i, proc);
+}
+
 static void push(PriorityQueue *q, const struct process *proc) {
     assert(proc);
-    assert(proc->current_burst);  // Defensive: can't push a proc without bursts
+    assert(proc_has_burst(proc));  // Defensive: can't push a proc without bursts
+    assert(q->heap_pos[proc->pid] < 0);  // already queued somewhere
 
     if (q->size == q->capacity) resize_queue(q);
 
-    int i = q->size - 1;
-    while (i >= 0 && q->array[i]->current_burst->remaining_time > proc->current_burst->remaining_time) {
-        q->array[i + 1] = q->array[i];
-        i--;
-    }
-    q->array[i + 1] = proc;
-    q->size++;
+    q->array[q->size] = proc;
+    sift_up(q, q->size++);
 }
 
 static const struct process *peek(PriorityQueue *q) {
@@ -49,17 +94,36 @@ static const struct process *peek(PriorityQueue *q) {
     return q->array[0];
 }
 
+// Removes the process in heap slot i
+static void remove_at(PriorityQueue *q, int i) {
+    q->heap_pos[q->array[i]->pid] = -1;
+    q->size--;
+    if (i == q->size) return;
+    place(q, i, q->array[q->size]);
+    if (i > 0 && runs_before(q->array[i], q->array[(i - 1) / 2]))
+        sift_up(q, i);
+    else
+        sift_down(q, i);
+}
+
 static void remove_process(PriorityQueue *q, const struct process *proc) {
     if (!q || !proc) return;
-    for (int i = 0; i < q->size; i++) {
-        if (q->array[i]->pid == proc->pid) {
-            for (int j = i; j < q->size - 1; j++) {
-                q->array[j] = q->array[j + 1];
-            }
-            q->size--;
-            return;
-        }
+    int i = q->heap_pos[proc->pid];
+    if (i < 0 || i >= q->size || q->array[i] != proc) return;  // not in this queue
+    remove_at(q, i);
+}
+
+// Removes and returns the process with the most remaining time.  The
+// maximum of a min-heap is one of its leaves, the back half of the array.
+static const struct process *pop_longest(PriorityQueue *q) {
+    assert(q->size > 0);
+    int longest = q->size / 2;
+    for (int i = longest + 1; i < q->size; i++) {
+        if (runs_before(q->array[longest], q->array[i])) longest = i;
     }
+    const struct process *proc = q->array[longest];
+    remove_at(q, longest);
+    return proc;
 }
 
 static void free_queue(PriorityQueue *q) {
@@ -68,82 +132,200 @@ static void free_queue(PriorityQueue *q) {
     free(q);
 }
 
-static void schedule_if_needed() {
-    if (!ready_queue) {
+// Picks the cpu for a newly ready process: the one with the fewest
+// processes queued or running (the lowest cpu wins ties)
+static int pick_cpu(Stcf *stcf) {
+    int best = 0;
+    int best_load = -1;
+    for (unsigned int cpu = 0; cpu < stcf->num_queues; cpu++) {
+        int load = stcf->ready_queues[cpu]->size + (stcf->current_procs[cpu] != NULL);
+        if (best_load < 0 || load < best_load) {
+            best = cpu;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+// Called when cpu has gone idle with nothing queued: moves the longest job
+// from the fullest other ready queue onto cpu.  Shortest jobs stay where
+// they are, since they are next to run on their own cpu anyway.
+static void steal(sim_t* sim, Stcf *stcf, int cpu) {
+    if (!get_work_stealing(sim)) return;
+    int victim = -1;
+    for (unsigned int other = 0; other < stcf->num_queues; other++) {
+        if ((int)other != cpu && stcf->ready_queues[other]->size > 0 &&
+            (victim < 0 || stcf->ready_queues[other]->size > stcf->ready_queues[victim]->size)) {
+            victim = other;
+        }
+    }
+    if (victim < 0) return;
+
+    const struct process *proc = pop_longest(stcf->ready_queues[victim]);
+    push(stcf->ready_queues[cpu], proc);
+    record_steal(sim, proc->pid, victim, cpu);
+}
+
+static void schedule_if_needed(sim_t* sim, Stcf *stcf, int cpu) {
+    if (!stcf->ready_queues) {
         fprintf(stderr, "ERROR: ready_queue is NULL!\n");
         exit(1);
     }
+    PriorityQueue *ready_queue = stcf->ready_queues[cpu];
+    const struct process *current_proc = stcf->current_procs[cpu];
 
     const struct process *next = peek(ready_queue);
-    if (!next || !next->current_burst) return;
+    if (!next || !proc_has_burst(next)) return;
 
-    pid_t current_pid = get_current_proc();
+    pid_t current_pid = get_current_proc_on(sim, cpu);
 
     // If CPU is idle or our local tracker is NULL or missing a burst
-    if (current_pid == -1 || current_proc == NULL || current_proc->current_burst == NULL) {
-        if (context_switch(next->pid) == 0) {
+    if (current_pid == -1 || current_proc == NULL || !proc_has_burst(current_proc)) {
+        if (context_switch_on(sim, cpu, next->pid) == 0) {
             // fprintf(stderr, "(debug) switching to proc %d (CPU idle)\n", next->pid);
-            current_proc = next;
+            stcf->current_procs[cpu] = next;
             remove_process(ready_queue, next);
         }
     } else {
         const struct process *current = current_proc;
 
-        if (!current->current_burst || next->current_burst->remaining_time < current->current_burst->remaining_time) {
-            if (context_switch(next->pid) == 0) {
+        if (!proc_has_burst(current) || proc_remaining_time(next) < proc_remaining_time(current)) {
+            if (context_switch_on(sim, cpu, next->pid) == 0) {
                 // fprintf(stderr, "(debug) preempting proc %d with proc %d\n", current->pid, next->pid);
+                // next is still the heap root; take it out before current goes in
+                remove_process(ready_queue, next);
                 if (current->state == READY) {
                     push(ready_queue, current);
                 }
-                current_proc = next;
-                remove_process(ready_queue, next);
+                stcf->current_procs[cpu] = next;
             }
         }
     }
 }
 
-void sched_init() {
-    use_time_slice(FALSE); // STCF is non-time-sliced
-    ready_queue = create_queue();
-    current_proc = NULL;
+static void sched_init(sim_t* sim) {
+    use_time_slice(sim, FALSE); // STCF is non-time-sliced
+    Stcf *stcf = malloc(sizeof(Stcf));
+    assert(stcf);
+    stcf->num_queues = get_num_cpus(sim);
+    stcf->ready_queues = malloc(stcf->num_queues * sizeof(PriorityQueue *));
+    stcf->current_procs = calloc(stcf->num_queues, sizeof(const struct process *));
+    stcf->num_procs = get_num_procs(sim);
+    stcf->heap_pos = malloc((stcf->num_procs + 1) * sizeof(int));
+    assert(stcf->ready_queues && stcf->current_procs && stcf->heap_pos);
+    for (unsigned int pid = 0; pid < stcf->num_procs; pid++) {
+        stcf->heap_pos[pid] = -1;
+    }
+    for (unsigned int cpu = 0; cpu < stcf->num_queues; cpu++) {
+        stcf->ready_queues[cpu] = create_queue(stcf->heap_pos);
+    }
+    set_sched_data(sim, stcf);
 }
 
-void sched_new_process(const struct process* proc) {
+static void sched_new_process(sim_t* sim, const struct process* proc) {
+    Stcf *stcf = get_sched_data(sim);
     assert(proc && proc->state == READY);
-    push(ready_queue, proc);
-    schedule_if_needed();
+    int cpu = pick_cpu(stcf);
+    push(stcf->ready_queues[cpu], proc);
+    schedule_if_needed(sim, stcf, cpu);
 }
 
-void sched_finished_time_slice(const struct process* proc) {
+static void sched_finished_time_slice(sim_t* sim, const struct process* proc) {
+    (void)sim;
     (void)proc; // Unused in STCF
 }
 
-void sched_blocked(const struct process* proc) {
+static void sched_blocked(sim_t* sim, const struct process* proc) {
+    Stcf *stcf = get_sched_data(sim);
     assert(proc && proc->state == BLOCKED);
-    if (proc == current_proc) {
-        current_proc = NULL;
+    int cpu = get_proc_cpu(sim, proc->pid);
+    if (proc == stcf->current_procs[cpu]) {
+        stcf->current_procs[cpu] = NULL;
     }
-    remove_process(ready_queue, proc);
-    schedule_if_needed();
+    remove_process(stcf->ready_queues[cpu], proc);
+    if (stcf->ready_queues[cpu]->size == 0) steal(sim, stcf, cpu);
+    schedule_if_needed(sim, stcf, cpu);
 }
 
-void sched_unblocked(const struct process* proc) {
+static void sched_unblocked(sim_t* sim, const struct process* proc) {
+    Stcf *stcf = get_sched_data(sim);
     assert(proc && proc->state == READY);
-    push(ready_queue, proc);
-    schedule_if_needed();
+    int cpu = pick_cpu(stcf);
+    push(stcf->ready_queues[cpu], proc);
+    schedule_if_needed(sim, stcf, cpu);
 }
 
-void sched_terminated(const struct process* proc) {
+static void sched_terminated(sim_t* sim, const struct process* proc) {
+    Stcf *stcf = get_sched_data(sim);
     assert(proc && proc->state == TERMINATED);
-    if (proc == current_proc) {
-        current_proc = NULL;
+    int cpu = get_proc_cpu(sim, proc->pid);
+    if (proc == stcf->current_procs[cpu]) {
+        stcf->current_procs[cpu] = NULL;
     }
-    remove_process(ready_queue, proc);
-    schedule_if_needed();
+    remove_process(stcf->ready_queues[cpu], proc);
+    if (stcf->ready_queues[cpu]->size == 0) steal(sim, stcf, cpu);
+    schedule_if_needed(sim, stcf, cpu);
 }
 
-void sched_cleanup() {
-    free_queue(ready_queue);
-    ready_queue = NULL;
-    current_proc = NULL;
+static void sched_free(void* data) {
+    Stcf *stcf = data;
+    for (unsigned int cpu = 0; cpu < stcf->num_queues; cpu++) {
+        free_queue(stcf->ready_queues[cpu]);
+    }
+    free(stcf->ready_queues);
+    free(stcf->current_procs);
+    free(stcf->heap_pos);
+    free(stcf);
 }
+
+static void sched_cleanup(sim_t* sim) {
+    sched_free(get_sched_data(sim));
+    set_sched_data(sim, NULL);
+}
+
+// Copies the heaps and heap_pos for a snapshot; each copied queue points at
+// the copy's own heap_pos
+static void* sched_clone(const void* data) {
+    const Stcf *stcf = data;
+    Stcf *copy = malloc(sizeof(Stcf));
+    assert(copy);
+    *copy = *stcf;
+    copy->ready_queues = malloc(stcf->num_queues * sizeof(PriorityQueue *));
+    copy->current_procs = malloc(stcf->num_queues * sizeof(const struct process *));
+    copy->heap_pos = malloc((stcf->num_procs + 1) * sizeof(int));
+    assert(copy->ready_queues && copy->current_procs && copy->heap_pos);
+    memcpy(copy->current_procs, stcf->current_procs, stcf->num_queues * sizeof(const struct process *));
+    memcpy(copy->heap_pos, stcf->heap_pos, stcf->num_procs * sizeof(int));
+    for (unsigned int cpu = 0; cpu < stcf->num_queues; cpu++) {
+        const PriorityQueue *q = stcf->ready_queues[cpu];
+        PriorityQueue *q_copy = create_queue(copy->heap_pos);
+        while (q_copy->capacity < q->size) resize_queue(q_copy);
+        memcpy(q_copy->array, q->array, q->size * sizeof(const struct process *));
+        q_copy->size = q->size;
+        copy->ready_queues[cpu] = q_copy;
+    }
+    return copy;
+}
+
+
+// The running process is kept out of the ready queues
+static unsigned int sched_queue_length(sim_t* sim, int cpu) {
+    Stcf *stcf = get_sched_data(sim);
+    return stcf->ready_queues[cpu]->size;
+}
+
+
+const struct sched_policy stcf_policy = {
+    "stcf",
+    sched_init,
+    sched_new_process,
+    sched_finished_time_slice,
+    sched_blocked,
+    sched_unblocked,
+    sched_terminated,
+    sched_cleanup,
+    sched_clone,
+    sched_free,
+    NULL,
+    sched_queue_length,
+};
@@ -2,149 +2,322 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 #define STRIDE_CONSTANT 1000000
-#define MAX_PID 32768
 
 typedef struct stride_proc {
-    const struct process* proc;
+    const struct process* proc;  // NULL until the process arrives and after it terminates
     unsigned long stride;
     unsigned long pass;
-    struct stride_proc* next;
+    unsigned long seq;  // when it was last queued; breaks pass ties first-come first-served
+    int cpu;            // whose ready heap this process is on
+    int heap_pos;       // slot in that heap, or -1 while not queued
 } stride_proc_t;
 
-static stride_proc_t* ready_list = NULL;
-static stride_proc_t* pid_map[MAX_PID];
+// A binary min-heap of ready processes ordered by (pass, seq), so a newly
+// queued process goes behind every other process with a pass <= its own.
+typedef struct {
+    stride_proc_t** array;
+    unsigned int size;
+    unsigned int capacity;
+} stride_heap_t;
 
-// Create and register a new stride_proc
-static stride_proc_t* create_stride_proc(const struct process* proc) {
-    stride_proc_t* sp = (stride_proc_t*)malloc(sizeof(stride_proc_t));
+// the state of one simulation
+typedef struct {
+    stride_heap_t* ready_heaps;   // one per cpu; the root of each is what runs there
+    unsigned int num_lists;
+    unsigned long next_seq;
+    stride_proc_t* stride_table;  // stride state for every pid, stored inline and indexed by pid
+    unsigned int table_size;
+} stride_sched_t;
+
+// Look up the stride state of a live process, or NULL
+static stride_proc_t* find_stride_proc(stride_sched_t* sched, pid_t pid) {
+    if (pid < 0 || (unsigned int)pid >= sched->table_size || !sched->stride_table[pid].proc) return NULL;
+    return &sched->stride_table[pid];
+}
+
+// Initialize the stride state of a newly arrived process
+static stride_proc_t* create_stride_proc(stride_sched_t* sched, const struct process* proc) {
+    assert(proc->pid >= 0 && (unsigned int)proc->pid < sched->table_size);
+    stride_proc_t* sp = &sched->stride_table[proc->pid];
     sp->proc = proc;
     sp->stride = STRIDE_CONSTANT / proc->tickets;
     sp->pass = 0;
-    sp->next = NULL;
-    pid_map[proc->pid] = sp;
+    sp->seq = 0;
+    sp->cpu = 0;
+    sp->heap_pos = -1;
     return sp;
 }
 
-// Sorted insert into ready_list by pass value
-static void add_to_ready_list(stride_proc_t* sp) {
-    if (!ready_list || sp->pass < ready_list->pass) {
-        sp->next = ready_list;
-        ready_list = sp;
-        return;
+// Pick the cpu with the smallest ready heap (lowest cpu wins ties)
+static int pick_cpu(stride_sched_t* sched) {
+    int best = 0;
+    for (unsigned int cpu = 1; cpu < sched->num_lists; ++cpu) {
+        if (sched->ready_heaps[cpu].size < sched->ready_heaps[best].size) {
+            best = cpu;
+        }
+    }
+    return best;
+}
+
+static int runs_before(const stride_proc_t* a, const stride_proc_t* b) {
+    if (a->pass != b->pass) return a->pass < b->pass;
+    return a->seq < b->seq;
+}
+
+static void place(stride_heap_t* heap, unsigned int i, stride_proc_t* sp) {
+    heap->array[i] = sp;
+    sp->heap_pos = i;
+}
+
+static void sift_up(stride_heap_t* heap, unsigned int i) {
+    stride_proc_t* sp = heap->array[i];
+    while (i > 0) {
+        unsigned int parent = (i - 1) / 2;
+        if (!runs_before(sp, heap->array[parent])) break;
+        place(heap, i, heap->array[parent]);
+        i = parent;
+    }
+    place(heap, i, sp);
+}
+
+static void sift_down(stride_heap_t* heap, unsigned int i) {
+    stride_proc_t* sp = heap->array[i];
+    for (;;) {
+        unsigned int child = 2 * i + 1;
+        if (child >= heap->size) break;
+        if (child + 1 < heap->size && runs_before(heap->array[child + 1], heap->array[child])) ++child;
+        if (!runs_before(heap->array[child], sp)) break;
+        place(heap, i, heap->array[child]);
+        i = child;
+    }
+    place(heap, i, sp);
+}
+
+// Queue sp on the ready heap of sp->cpu, behind anything with an equal pass
+static void add_to_ready_list(stride_sched_t* sched, stride_proc_t* sp) {
+    stride_heap_t* heap = &sched->ready_heaps[sp->cpu];
+    assert(sp->heap_pos < 0);
+    if (heap->size == heap->capacity) {
+        heap->capacity = heap->capacity ? heap->capacity * 2 : 16;
+        heap->array = realloc(heap->array, heap->capacity * sizeof(stride_proc_t*));
+        assert(heap->array);
+    }
+    sp->seq = sched->next_seq++;
+    heap->array[heap->size] = sp;
+    sift_up(heap, heap->size++);
+}
+
+// Remove a process from its cpu's ready heap
+static void remove_from_ready_list(stride_sched_t* sched, pid_t pid) {
+    stride_proc_t* sp = find_stride_proc(sched, pid);
+    if (!sp || sp->heap_pos < 0) return;
+    stride_heap_t* heap = &sched->ready_heaps[sp->cpu];
+    unsigned int i = sp->heap_pos;
+    sp->heap_pos = -1;
+    if (i == --heap->size) return;
+    place(heap, i, heap->array[heap->size]);
+    if (i > 0 && runs_before(heap->array[i], heap->array[(i - 1) / 2])) {
+        sift_up(heap, i);
+    } else {
+        sift_down(heap, i);
     }
-    stride_proc_t* curr = ready_list;
-    while (curr->next && curr->next->pass <= sp->pass) {
-        curr = curr->next;
+}
+
+// Called when cpu's ready heap has emptied: moves the READY process that
+// would wait longest (highest pass, then latest queued) from the largest
+// other heap onto cpu.  Processes running on the other cpus are never taken.
+static void steal(sim_t* sim, stride_sched_t* sched, int cpu) {
+    if (!get_work_stealing(sim)) return;
+    int victim = -1;
+    for (unsigned int other = 0; other < sched->num_lists; ++other) {
+        if ((int)other != cpu && sched->ready_heaps[other].size > 1 &&
+            (victim < 0 || sched->ready_heaps[other].size > sched->ready_heaps[victim].size)) {
+            victim = other;
+        }
     }
-    sp->next = curr->next;
-    curr->next = sp;
-}
-
-// Remove a process from the ready list
-static void remove_from_ready_list(pid_t pid) {
-    stride_proc_t** curr = &ready_list;
-    while (*curr) {
-        if ((*curr)->proc->pid == pid) {
-            stride_proc_t* to_remove = *curr;
-            *curr = (*curr)->next;
-            to_remove->next = NULL;
-            return;
+    if (victim < 0) return;
+
+    pid_t running = get_current_proc_on(sim, victim);
+    stride_proc_t* last = NULL;
+    for (unsigned int i = 0; i < sched->ready_heaps[victim].size; ++i) {
+        stride_proc_t* curr = sched->ready_heaps[victim].array[i];
+        if (curr->proc->pid != running && (!last || runs_before(last, curr))) {
+            last = curr;
         }
-        curr = &(*curr)->next;
     }
+    if (!last) return;
+
+    remove_from_ready_list(sched, last->proc->pid);
+    last->cpu = cpu;
+    add_to_ready_list(sched, last);
+    record_steal(sim, last->proc->pid, victim, cpu);
 }
 
 // Only switch if necessary
-static void schedule_next() {
-    if (!ready_list) return;
+static void schedule_next(sim_t* sim, stride_sched_t* sched, int cpu) {
+    if (sched->ready_heaps[cpu].size == 0) return;
+    stride_proc_t* head = sched->ready_heaps[cpu].array[0];
 
-    pid_t next = ready_list->proc->pid;
-    if (ready_list->proc->state != READY) return;  // ✅ Prevent bad switch
+    pid_t next = head->proc->pid;
+    if (head->proc->state != READY) return;  // ✅ Prevent bad switch
 
-    pid_t current = get_current_proc();
+    pid_t current = get_current_proc_on(sim, cpu);
     if (current != next) {
-        context_switch(next);
+        context_switch_on(sim, cpu, next);
     }
 }
 
 // Increment pass for the given process
-static void update_pass(pid_t pid) {
-    stride_proc_t* sp = pid_map[pid];
+static void update_pass(stride_sched_t* sched, pid_t pid) {
+    stride_proc_t* sp = find_stride_proc(sched, pid);
     if (sp) {
         sp->pass += sp->stride;
     }
 }
 
-void sched_init() {
-    use_time_slice(TRUE);
-    for (int i = 0; i < MAX_PID; ++i) {
-        pid_map[i] = NULL;
-    }
+static void sched_init(sim_t* sim) {
+    use_time_slice(sim, TRUE);
+    stride_sched_t* sched = malloc(sizeof(stride_sched_t));
+    assert(sched);
+    sched->num_lists = get_num_cpus(sim);
+    sched->ready_heaps = calloc(sched->num_lists, sizeof(stride_heap_t));
+    sched->next_seq = 0;
+    sched->table_size = get_num_procs(sim);
+    sched->stride_table = calloc(sched->table_size ? sched->table_size : 1, sizeof(stride_proc_t));
+    assert(sched->ready_heaps && sched->stride_table);
+    set_sched_data(sim, sched);
 }
 
-void sched_new_process(const struct process* proc) {
+static void sched_new_process(sim_t* sim, const struct process* proc) {
+    stride_sched_t* sched = get_sched_data(sim);
     assert(READY == proc->state);
-    stride_proc_t* sp = create_stride_proc(proc);
+    stride_proc_t* sp = create_stride_proc(sched, proc);
     sp->proc = proc;
-    add_to_ready_list(sp);
-    if (get_current_proc() == -1) {
-        schedule_next();
+    sp->cpu = pick_cpu(sched);
+    add_to_ready_list(sched, sp);
+    if (get_current_proc_on(sim, sp->cpu) == -1) {
+        schedule_next(sim, sched, sp->cpu);
     }
 }
 
-void sched_finished_time_slice(const struct process* proc) {
+static void sched_finished_time_slice(sim_t* sim, const struct process* proc) {
+    stride_sched_t* sched = get_sched_data(sim);
     pid_t pid = proc->pid;
-    stride_proc_t* sp = pid_map[pid];
+    stride_proc_t* sp = find_stride_proc(sched, pid);
     if (!sp) return;
 
     // Advance pass
-    update_pass(pid);
+    update_pass(sched, pid);
 
     // Remove and re-add to ready list (only if it’s still in CPU_BURST)
-    remove_from_ready_list(pid);
-    add_to_ready_list(sp);
+    remove_from_ready_list(sched, pid);
+    add_to_ready_list(sched, sp);
 
-    schedule_next();
+    schedule_next(sim, sched, sp->cpu);
 }
 
-void sched_blocked(const struct process* proc) {
+static void sched_blocked(sim_t* sim, const struct process* proc) {
+    stride_sched_t* sched = get_sched_data(sim);
     assert(BLOCKED == proc->state);
-    update_pass(proc->pid);
-    remove_from_ready_list(proc->pid);
-    schedule_next();
+    update_pass(sched, proc->pid);
+    remove_from_ready_list(sched, proc->pid);
+    int cpu = find_stride_proc(sched, proc->pid)->cpu;
+    if (sched->ready_heaps[cpu].size == 0) steal(sim, sched, cpu);
+    schedule_next(sim, sched, cpu);
 }
 
-void sched_unblocked(const struct process* proc) {
+static void sched_unblocked(sim_t* sim, const struct process* proc) {
+    stride_sched_t* sched = get_sched_data(sim);
     assert(READY == proc->state);
-    stride_proc_t* sp = pid_map[proc->pid];
+    stride_proc_t* sp = find_stride_proc(sched, proc->pid);
     if (!sp) return;
 
     sp->proc = proc;  // ✅ Update to current process struct
 
-    add_to_ready_list(sp);
+    sp->cpu = pick_cpu(sched);
+    add_to_ready_list(sched, sp);
 
-    if (get_current_proc() == -1) {
-        schedule_next();
+    if (get_current_proc_on(sim, sp->cpu) == -1) {
+        schedule_next(sim, sched, sp->cpu);
     }
 }
 
-void sched_terminated(const struct process* proc) {
+static void sched_terminated(sim_t* sim, const struct process* proc) {
+    stride_sched_t* sched = get_sched_data(sim);
     assert(TERMINATED == proc->state);
-    update_pass(proc->pid);
-    remove_from_ready_list(proc->pid);
-    free(pid_map[proc->pid]);
-    pid_map[proc->pid] = NULL;
-    schedule_next();
-}
-
-void sched_cleanup() {
-    for (int i = 0; i < MAX_PID; ++i) {
-        if (pid_map[i]) {
-            free(pid_map[i]);
-            pid_map[i] = NULL;
+    update_pass(sched, proc->pid);
+    remove_from_ready_list(sched, proc->pid);
+    stride_proc_t* sp = find_stride_proc(sched, proc->pid);
+    int cpu = sp ? sp->cpu : 0;
+    if (sp) memset(sp, 0, sizeof(stride_proc_t));
+    if (sched->ready_heaps[cpu].size == 0) steal(sim, sched, cpu);
+    schedule_next(sim, sched, cpu);
+}
+
+static void sched_free(void* data) {
+    stride_sched_t* sched = data;
+    free(sched->stride_table);
+    for (unsigned int cpu = 0; cpu < sched->num_lists; ++cpu) {
+        free(sched->ready_heaps[cpu].array);
+    }
+    free(sched->ready_heaps);
+    free(sched);
+}
+
+static void sched_cleanup(sim_t* sim) {
+    sched_free(get_sched_data(sim));
+    set_sched_data(sim, NULL);
+}
+
+// Copy the table and heaps for a snapshot; the heaps point into the table,
+// so each entry is moved to the same slot of the copy's table
+static void* sched_clone(const void* data) {
+    const stride_sched_t* sched = data;
+    stride_sched_t* copy = malloc(sizeof(stride_sched_t));
+    assert(copy);
+    *copy = *sched;
+    size_t table_bytes = (sched->table_size ? sched->table_size : 1) * sizeof(stride_proc_t);
+    copy->stride_table = malloc(table_bytes);
+    copy->ready_heaps = calloc(sched->num_lists, sizeof(stride_heap_t));
+    assert(copy->stride_table && copy->ready_heaps);
+    memcpy(copy->stride_table, sched->stride_table, table_bytes);
+    for (unsigned int cpu = 0; cpu < sched->num_lists; ++cpu) {
+        const stride_heap_t* heap = &sched->ready_heaps[cpu];
+        stride_heap_t* heap_copy = &copy->ready_heaps[cpu];
+        heap_copy->size = heap->size;
+        heap_copy->capacity = heap->capacity;
+        heap_copy->array = malloc(heap->capacity * sizeof(stride_proc_t*));
+        assert(heap->capacity == 0 || heap_copy->array);
+        for (unsigned int i = 0; i < heap->size; ++i) {
+            heap_copy->array[i] = &copy->stride_table[heap->array[i] - sched->stride_table];
         }
     }
-    ready_list = NULL;
+    return copy;
 }
+
+
+// The root of cpu's heap is the process running there, if any
+static unsigned int sched_queue_length(sim_t* sim, int cpu) {
+    stride_sched_t* sched = get_sched_data(sim);
+    unsigned int size = sched->ready_heaps[cpu].size;
+    return (size > 0 && get_current_proc_on(sim, cpu) != -1) ? size - 1 : size;
+}
+
+
+const struct sched_policy stride_policy = {
+    "stride",
+    sched_init,
+    sched_new_process,
+    sched_finished_time_slice,
+    sched_blocked,
+    sched_unblocked,
+    sched_terminated,
+    sched_cleanup,
+    sched_clone,
+    sched_free,
+    NULL,
+    sched_queue_length,
+};
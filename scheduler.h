@@ -3,76 +3,127 @@
 
 #include "process.h"
 
+/* one simulation: every hook receives the simulation it belongs to, and
+ * every call below acts on the simulation it is given */
+typedef struct simulation sim_t;
+
+/* since C doesn't have a native boolean type, we made one */
+typedef enum {FALSE=0, TRUE=1} bool_t;
+
+
 /*****************************
  * Implement These Functions *
  *****************************/
 
-/* sched_init
- *   will be called exactly once before any processes arrive or any other events
- */
-void sched_init();
-
-/* sched_new_process
- *   will be called when a new process arrives (i.e., fork())
+/* A policy implements the hooks below and hands them to the simulator as one
+ * struct sched_policy.  Define the hooks static and export the struct, e.g.
  *
- * proc - the new process that just arrived
- */
-void sched_new_process(const struct process* proc);
-
-/* sched_finished_time_slice
- *   will be called when the currently running process finished a time slice
- *   (This is only called when the time slice ends with time remaining in the
- *   current CPU burst.  If finishing the time slice happens at the same time
- *   that the process blocks / terminates,
- *   then sched_blocked() / sched_terminated() will be called instead).
+ *   const struct sched_policy rr_policy = {"rr", sched_init, sched_new_process, ...};
  *
- * proc - the process whose time slice just ended
+ * Built-in policies are listed in policy.c.  A policy built as a shared
+ * object (cc -shared -fPIC) exports its struct as "sched_policy" instead and
+ * is loaded with --policy path/to/policy.so.
  *
- * Note: Time slice end events only occur if use_time_slice() is set to TRUE
+ * The same policy may be run several times in one process (see --policy),
+ * and several simulations may run it at once, so a policy keeps its state
+ * with set_sched_data() rather than in globals.
  */
-void sched_finished_time_slice(const struct process* proc);
+struct sched_policy {
+  const char* name;
 
-/* sched_blocked
- *   will be called when the currently running process blocks
- *   (e.g., if it starts an I/O operation that it needs to wait to finish
- *
- * proc - the process that just blocked
- */
-void sched_blocked(const struct process* proc);
+  /* sched_init
+   *   will be called exactly once before any processes arrive or any other events
+   */
+  void (*sched_init)(sim_t* sim);
 
-/* sched_unblocked
- *   will be called when a blocked process unblocks
- *   (e.g., if its I/O operation finished)
- *
- * proc - the process that just unblocked
- */
-void sched_unblocked(const struct process* proc);
+  /* sched_new_process
+   *   will be called when a new process arrives (i.e., fork())
+   *
+   * proc - the new process that just arrived
+   */
+  void (*sched_new_process)(sim_t* sim, const struct process* proc);
 
-/* sched_terminated
- *   will be called when the currently running process terminates
- *   (i.e., it finished it's last CPU burst)
- *
- * proc - the process that just terminated
- *
- * Note: "kill" commands and other ways to terminate a process that is not
- *       currently running are not being simulated, so only the currently running
- *       process can actually terminate.
- */
-void sched_terminated(const struct process* proc);
+  /* sched_finished_time_slice
+   *   will be called when the currently running process finished a time slice
+   *   (This is only called when the time slice ends with time remaining in the
+   *   current CPU burst.  If finishing the time slice happens at the same time
+   *   that the process blocks / terminates,
+   *   then sched_blocked() / sched_terminated() will be called instead).
+   *
+   * proc - the process whose time slice just ended
+   *
+   * Note: Time slice end events only occur if use_time_slice() is set to TRUE
+   */
+  void (*sched_finished_time_slice)(sim_t* sim, const struct process* proc);
 
-/* sched_cleanup
- *   will be called exactly once after all processes have terminated and there
- *   are no more events left to occur, just before the simulation exits
- *
- * Note: Calling sched_cleanup() is guaranteed if the simulation has a normal exit
- *       but is not guaranteed in the case of fatal errors, crashes, or other
- *       abnormal exits.
- */
-void sched_cleanup();
+  /* sched_blocked
+   *   will be called when the currently running process blocks
+   *   (e.g., if it starts an I/O operation that it needs to wait to finish
+   *
+   * proc - the process that just blocked
+   */
+  void (*sched_blocked)(sim_t* sim, const struct process* proc);
+
+  /* sched_unblocked
+   *   will be called when a blocked process unblocks
+   *   (e.g., if its I/O operation finished)
+   *
+   * proc - the process that just unblocked
+   */
+  void (*sched_unblocked)(sim_t* sim, const struct process* proc);
+
+  /* sched_terminated
+   *   will be called when the currently running process terminates
+   *   (i.e., it finished it's last CPU burst)
+   *
+   * proc - the process that just terminated
+   *
+   * Note: "kill" commands and other ways to terminate a process that is not
+   *       currently running are not being simulated, so only the currently running
+   *       process can actually terminate.
+   */
+  void (*sched_terminated)(sim_t* sim, const struct process* proc);
+
+  /* sched_cleanup
+   *   will be called exactly once after all processes have terminated and there
+   *   are no more events left to occur, just before the simulation exits
+   *
+   * Note: Calling sched_cleanup() is guaranteed if the simulation has a normal exit
+   *       but is not guaranteed in the case of fatal errors, crashes, or other
+   *       abnormal exits.
+   */
+  void (*sched_cleanup)(sim_t* sim);
+
+  /* sched_clone (optional)
+   *   returns a separate deep copy of data, a value this policy registered
+   *   with set_sched_data(), for sim_snapshot().  Pointers to processes may be
+   *   copied as they are, since a snapshot is only ever restored into the
+   *   simulation it was taken from.  Leave NULL if the policy cannot be
+   *   snapshotted.
+   */
+  void* (*sched_clone)(const void* data);
+
+  /* sched_free (required with sched_clone)
+   *   frees a copy made by sched_clone()
+   */
+  void (*sched_free)(void* data);
+
+  /* sched_timer (optional)
+   *   will be called when the timer set with set_timer() goes off.  Leave
+   *   NULL if the policy never sets a timer.
+   */
+  void (*sched_timer)(sim_t* sim);
+
+  /* sched_queue_length (optional)
+   *   returns how many READY processes are waiting in the queue cpu takes its
+   *   next process from, not counting any process running.  Only used to
+   *   charge --decision-cost, after each of the hooks above.  Leave NULL if
+   *   all cpus share one queue: every READY process not running is counted.
+   */
+  unsigned int (*sched_queue_length)(sim_t* sim, int cpu);
+};
 
 
-/* since C doesn't have a native boolean type, we made one */
-typedef enum {FALSE=0, TRUE=1} bool_t;
 
 
 /************************************
@@ -89,8 +140,12 @@ typedef enum {FALSE=0, TRUE=1} bool_t;
  *
  * Note: does NOT set errno on failure (unlike real syscalls), but will print
  *       a warning message saying what went wrong
+ *
+ * Note: a run may charge for switching (--switch-cost and --migration-cost);
+ *       the charge is added to pid's cpu burst, and its time slice only
+ *       starts once the charge has been paid.
  */
-int context_switch(pid_t pid);
+int context_switch(sim_t* sim, pid_t pid);
 
 /* get_current_proc
  *   gets the pid of the current process
@@ -98,14 +153,111 @@ int context_switch(pid_t pid);
  * returns the process ID of the currently running process,
  * or -1 if the CPU is idle (i.e., no process is currently running)
  */
-pid_t get_current_proc();
+pid_t get_current_proc(sim_t* sim);
+
+
+/**********************************************************************
+ * Multi-CPU versions (the functions above act on cpu 0)              *
+ * CPUs are numbered 0 .. get_num_cpus() - 1, and a simulation run    *
+ * with --cpus N calls the same sched_* hooks as a single-cpu run.    *
+ **********************************************************************/
+
+/* get_num_cpus
+ *   returns the number of cpus being simulated (at least 1)
+ */
+unsigned int get_num_cpus(sim_t* sim);
+
+/* context_switch_on
+ *   same as context_switch(), but changes the process running on cpu
+ *
+ * returns 0 on success or -1 on failure (including when pid is already
+ * running on another cpu), in which case nothing changes
+ */
+int context_switch_on(sim_t* sim, int cpu, pid_t pid);
+
+/* context_switch_with_slice, context_switch_on_with_slice
+ *   same as context_switch() and context_switch_on(), but pid runs for at
+ *   most slice ticks (0 for no limit) before sched_finished_time_slice() is
+ *   called, whatever get_time_slice() says.  If pid keeps running after its
+ *   slice ends, it gets the same slice again unless rearm_time_slice() is
+ *   called.
+ */
+int context_switch_with_slice(sim_t* sim, pid_t pid, time_ticks_t slice);
+int context_switch_on_with_slice(sim_t* sim, int cpu, pid_t pid, time_ticks_t slice);
+
+/* rearm_time_slice
+ *   starts a new time slice of slice ticks (0 for no limit), from now, for
+ *   the process running on cpu, replacing whatever was left of its current
+ *   one.  Call it from sched_finished_time_slice() to give the process that
+ *   keeps running a different quantum, or at any time to shorten or extend
+ *   the running process' slice.
+ *
+ * returns 0 on success or -1 if cpu is idle or invalid, after a warning
+ */
+int rearm_time_slice(sim_t* sim, int cpu, time_ticks_t slice);
+
+/* get_current_proc_on
+ *   returns the pid of the process running on cpu, or -1 if cpu is idle
+ */
+pid_t get_current_proc_on(sim_t* sim, int cpu);
+
+/* get_proc_cpu
+ *   returns the cpu pid is running on or, if it is not running, the cpu it
+ *   last ran on; -1 if it has never run
+ *
+ * Note: inside sched_finished_time_slice(), sched_blocked() and
+ *       sched_terminated() this is the cpu the process was just running on.
+ */
+int get_proc_cpu(sim_t* sim, pid_t pid);
+
+/* get_work_stealing
+ *   returns TRUE if a cpu that runs out of work should take a READY process
+ *   from another cpu's queue (only ever TRUE with more than one cpu)
+ */
+bool_t get_work_stealing(sim_t* sim);
+
+/* record_steal
+ *   call this after moving pid from from_cpu's queue to to_cpu's queue so the
+ *   steal shows up in the metrics
+ *
+ * Note: the move itself is not charged; context_switch_on() charges the
+ *       --migration-cost when pid next runs on a cpu other than its last one.
+ */
+void record_steal(sim_t* sim, pid_t pid, int from_cpu, int to_cpu);
+
+/* set_sched_data, get_sched_data
+ *   a policy keeps all of its state in one allocation registered with
+ *   set_sched_data() in sched_init() and freed in sched_cleanup().  Each
+ *   simulation has its own, so policies must not keep state in globals or
+ *   file-statics.
+ */
+void set_sched_data(sim_t* sim, void* data);
+void* get_sched_data(sim_t* sim);
+
+/* get_num_procs
+ *   returns the number of processes in the trace; pids are numbered
+ *   0 .. get_num_procs() - 1, so policies can size per-pid tables in sched_init()
+ */
+unsigned int get_num_procs(sim_t* sim);
+
+/* get_seed
+ *   returns the seed for this run (--seed, 0 by default); a policy that makes
+ *   random choices seeds its generator with it, so that a run can be repeated
+ *   exactly
+ */
+unsigned long get_seed(sim_t* sim);
+
+/* get_current_time
+ *   returns the simulated time now, in ticks
+ */
+time_ticks_t get_current_time(sim_t* sim);
 
 /* get_time_slice
  *   gets the time slice parameter value
  *
  * returns the number of ticks in each time slice, or 0 if time slices are not in use
  */
-time_ticks_t get_time_slice();
+time_ticks_t get_time_slice(sim_t* sim);
 
 /* use_time_slice
  *   sets whether to use time slices
@@ -114,13 +266,31 @@ time_ticks_t get_time_slice();
  *       or FALSE if you do not (in which case the current process will just
  *       keep running until the next event)
  */
-void use_time_slice(bool_t use);
+void use_time_slice(sim_t* sim, bool_t use);
+
+/* set_time_slice
+ *   sets the time slice to ticks (0 turns time slices off); every later
+ *   context_switch() or context_switch_on() dispatches with it.
+ *   use_time_slice(TRUE) goes back to the trace's.  To give one dispatch its
+ *   own quantum, use context_switch_with_slice() instead.
+ */
+void set_time_slice(sim_t* sim, time_ticks_t ticks);
+
+/* set_timer
+ *   asks for the policy's sched_timer() to be called delay ticks from now
+ *   (delay > 0).  There is at most one timer per simulation, so this replaces
+ *   any timer that has not gone off yet.
+ *
+ * Note: a pending timer does not keep the simulation going once every
+ *       process has terminated.
+ */
+void set_timer(sim_t* sim, time_ticks_t delay);
 
 /* print_process_list
  *   prints every process in the simulation to stderr
  *   This reflects all process' current state at the time this function is called.
  */
-void print_process_list();
+void print_process_list(sim_t* sim);
 
 #endif /* _SCHEDULER_H_ */
 
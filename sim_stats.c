@@ -0,0 +1,66 @@
+
+#include "sim_stats.h"
+#include <time.h>
+
+// built only into the -DSIM_STATS variant; see the Makefile's stats target
+
+static const char* hook_strings[] = {"sched_init", "sched_new_process", "sched_finished_time_slice",
+                                     "sched_blocked", "sched_unblocked", "sched_terminated", "sched_cleanup",
+                                     "sched_timer"};
+
+
+uint64_t stats_clock() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+void stats_hook(struct sim_stats* stats, hook_t hook, uint64_t ns) {
+  struct hook_stats* hook_stats = &stats->hooks[hook];
+  ++hook_stats->calls;
+  hook_stats->total_ns += ns;
+  if (ns > hook_stats->max_ns)
+    hook_stats->max_ns = ns;
+}
+
+
+static double per(double total, unsigned long count) {
+  return (count > 0) ? total / count : 0.0;
+}
+
+
+void print_sim_stats(FILE* out, const char* policy_name, const struct sim_stats* stats,
+                     const struct queue_stats* queue) {
+  unsigned long num_events = 0;
+  for (int type = 0; type < NUM_EVENT_TYPES; ++type) {
+    num_events += stats->events[type];
+  }
+  fprintf(out, "\nSIM_STATS %s: %lu events in %.3f ms (%.1f ns/event)\n", policy_name, num_events,
+          stats->step_ns / 1e6, per(stats->step_ns, num_events));
+  for (int type = 0; type < NUM_EVENT_TYPES; ++type) {
+    fprintf(out, "  %-26s %10lu\n", event_type_string(type), stats->events[type]);
+  }
+
+  fprintf(out, "  event queue: %lu inserts, %.2f levels up each; %lu removals, %.2f levels down "
+          "and %.2f nodes scanned each; %lu tombstones; at most %zu queued\n",
+          queue->inserts, per(queue->sift_up_levels, queue->inserts), queue->removals,
+          per(queue->sift_down_levels, queue->removals), per(queue->children_scanned, queue->removals),
+          queue->tombstones, queue->peak_size);
+  fprintf(out, "  context_switch: %lu calls, %lu refused\n", stats->context_switches,
+          stats->context_switch_failures);
+
+  uint64_t hook_ns = 0;
+  fprintf(out, "  %-26s %10s %12s %10s %10s\n", "hook", "calls", "total ms", "mean ns", "max ns");
+  for (int hook = 0; hook < NUM_HOOKS; ++hook) {
+    const struct hook_stats* hook_stats = &stats->hooks[hook];
+    fprintf(out, "  %-26s %10lu %12.3f %10.1f %10lu\n", hook_strings[hook], hook_stats->calls,
+            hook_stats->total_ns / 1e6, per(hook_stats->total_ns, hook_stats->calls),
+            (unsigned long)hook_stats->max_ns);
+    if (HOOK_INIT != hook && HOOK_CLEANUP != hook)
+      hook_ns += hook_stats->total_ns;
+  }
+  // init and cleanup run outside sim_step()
+  fprintf(out, "  event loop outside the hooks: %.3f ms\n",
+          (stats->step_ns > hook_ns) ? (stats->step_ns - hook_ns) / 1e6 : 0.0);
+}
@@ -0,0 +1,70 @@
+#ifndef _SIM_STATS_H_
+#define _SIM_STATS_H_
+
+#include "event.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* Instrumentation of the event loop, compiled in only by a -DSIM_STATS build
+ * (make stats builds simulate_stats that way).  Each finished run then prints
+ * to stderr how many events of each type it handled, how much work the event
+ * heap did, how many context switches were asked for and refused, and how
+ * long each scheduler hook took.
+ *
+ * Without SIM_STATS every SIM_STAT() compiles to nothing, none of the structs
+ * below is part of any other struct, and sim_stats.c is not even built, so
+ * the normal build pays nothing for any of it. */
+#ifdef SIM_STATS
+#define SIM_STAT(statement) do { statement; } while (0)
+#else
+#define SIM_STAT(statement) do { } while (0)
+#endif
+
+/* work done by one event queue */
+struct queue_stats {
+  unsigned long inserts;
+  unsigned long sift_up_levels;   // levels events moved up the heap
+  unsigned long removals;         // events taken off the heap, tombstones included
+  unsigned long sift_down_levels; // levels events moved down the heap
+  unsigned long children_scanned; // heap nodes compared while sifting down
+  unsigned long tombstones;       // cancelled events discarded
+  size_t peak_size;
+};
+
+typedef enum {
+  HOOK_INIT, HOOK_NEW_PROCESS, HOOK_FINISHED_TIME_SLICE, HOOK_BLOCKED, HOOK_UNBLOCKED, HOOK_TERMINATED,
+  HOOK_CLEANUP, HOOK_TIMER, NUM_HOOKS
+} hook_t;
+
+struct hook_stats {
+  unsigned long calls;
+  uint64_t total_ns; // includes any context switches the hook made
+  uint64_t max_ns;
+};
+
+/* everything else one run counts; see also struct queue_stats */
+struct sim_stats {
+  unsigned long events[NUM_EVENT_TYPES]; // handled, by type
+  unsigned long context_switches;        // calls to context_switch_on()
+  unsigned long context_switch_failures; // of those, calls that were refused
+  struct hook_stats hooks[NUM_HOOKS];
+  uint64_t step_ns;                      // total time in sim_step(), hooks included
+};
+
+/* stats_clock
+ *   returns a monotonic timestamp in nanoseconds
+ */
+uint64_t stats_clock();
+
+/* stats_hook
+ *   records one call of a scheduler hook that took ns nanoseconds
+ */
+void stats_hook(struct sim_stats* stats, hook_t hook, uint64_t ns);
+
+/* print_sim_stats
+ *   prints a summary of one run's statistics to out
+ */
+void print_sim_stats(FILE* out, const char* policy_name, const struct sim_stats* stats,
+                     const struct queue_stats* queue);
+
+#endif /* _SIM_STATS_H_ */
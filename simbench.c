@@ -0,0 +1,272 @@
+
+#include "simulation.h"
+#include "policy.h"
+#include "options.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* simbench
+ *   times the simulation engine: every policy over every trace, each run in
+ *   a child process of its own so its peak RSS is its own.  The trace output
+ *   goes to /dev/null in quiet mode, so the timings are of the event loop
+ *   and the policies rather than of formatting.
+ *
+ * Allocations are counted by wrapping malloc and friends at link time
+ * (-Wl,--wrap=malloc,...; see the Makefile), which catches every allocation
+ * the simulator's own objects make.
+ */
+
+static unsigned long num_allocs = 0;
+static unsigned long alloc_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  ++num_allocs;
+  alloc_bytes += size;
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  ++num_allocs;
+  alloc_bytes += count * size;
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  ++num_allocs;
+  alloc_bytes += size;
+  return __real_realloc(ptr, size);
+}
+
+
+// what one run measures; sent from the child to the parent through a pipe
+struct bench_result {
+  int ok;
+  unsigned int procs;
+  unsigned long events;
+  double load_seconds;
+  double run_seconds;
+  unsigned long allocs;      // during the run only, not the load
+  unsigned long alloc_bytes;
+  long peak_rss_kb;          // filled in by the parent
+};
+
+
+static double now_seconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+static void run_one(const char* trace, const struct sched_policy* policy, const struct sim_options* options,
+                    struct bench_result* result) {
+  memset(result, 0, sizeof(struct bench_result));
+  FILE* devnull = fopen("/dev/null", "w");
+  if (NULL == devnull) {
+    perror("ERROR opening /dev/null");
+    return;
+  }
+
+  sim_t* sim = sim_create();
+  double start = now_seconds();
+  if (0 == sim_load(sim, trace, FALSE)) {
+    result->load_seconds = now_seconds() - start;
+    unsigned long allocs_before = num_allocs;
+    unsigned long bytes_before = alloc_bytes;
+
+    start = now_seconds();
+    if (0 == sim_start(sim, policy, options, devnull)) {
+      while (sim_step(sim))
+        ;
+      result->events = sim_events(sim);
+      result->ok = (0 == sim_finish(sim));
+    }
+    result->run_seconds = now_seconds() - start;
+    result->allocs = num_allocs - allocs_before;
+    result->alloc_bytes = alloc_bytes - bytes_before;
+    result->procs = sim_num_procs(sim);
+  }
+  sim_destroy(sim);
+  fclose(devnull);
+}
+
+
+// runs one benchmark in a child process; returns 0 if it ran to the end
+static int bench_one(const char* trace, const struct sched_policy* policy, const struct sim_options* options,
+                     struct bench_result* result) {
+  memset(result, 0, sizeof(struct bench_result));
+  int fds[2];
+  if (0 != pipe(fds)) {
+    perror("ERROR creating pipe");
+    return -1;
+  }
+  fflush(NULL);
+  pid_t child = fork();
+  if (child < 0) {
+    perror("ERROR forking");
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+  if (0 == child) {
+    close(fds[0]);
+    run_one(trace, policy, options, result);
+    ssize_t written = write(fds[1], result, sizeof(struct bench_result));
+    _exit(written == (ssize_t)sizeof(struct bench_result) ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  close(fds[1]);
+  ssize_t got = read(fds[0], result, sizeof(struct bench_result));
+  close(fds[0]);
+  int status = 0;
+  struct rusage usage;
+  if (child != wait4(child, &status, 0, &usage)) {
+    perror("ERROR waiting for benchmark");
+    return -1;
+  }
+  if (got != (ssize_t)sizeof(struct bench_result) || !WIFEXITED(status) || EXIT_SUCCESS != WEXITSTATUS(status)) {
+    result->ok = 0;
+    return -1;
+  }
+  result->peak_rss_kb = usage.ru_maxrss;
+  return result->ok ? 0 : -1;
+}
+
+
+static void write_header(FILE* out, int json) {
+  if (json)
+    fprintf(out, "[\n");
+  else
+    fprintf(out, "trace,policy,cpus,procs,events,load_ms,run_ms,events_per_sec,ns_per_event,"
+            "peak_rss_kb,allocs,alloc_bytes\n");
+}
+
+
+static void write_result(FILE* out, int json, int first, const char* trace, const char* policy_name,
+                         unsigned int cpus, const struct bench_result* result) {
+  double events_per_sec = (result->run_seconds > 0) ? result->events / result->run_seconds : 0.0;
+  double ns_per_event = (result->events > 0) ? result->run_seconds * 1e9 / result->events : 0.0;
+  if (json)
+    fprintf(out, "%s  {\"trace\": \"%s\", \"policy\": \"%s\", \"cpus\": %u, \"procs\": %u, \"events\": %lu, "
+            "\"load_ms\": %.3f, \"run_ms\": %.3f, \"events_per_sec\": %.0f, \"ns_per_event\": %.2f, "
+            "\"peak_rss_kb\": %ld, \"allocs\": %lu, \"alloc_bytes\": %lu}",
+            first ? "" : ",\n", trace, policy_name, cpus, result->procs, result->events,
+            result->load_seconds * 1e3, result->run_seconds * 1e3, events_per_sec, ns_per_event,
+            result->peak_rss_kb, result->allocs, result->alloc_bytes);
+  else
+    fprintf(out, "%s,%s,%u,%u,%lu,%.3f,%.3f,%.0f,%.2f,%ld,%lu,%lu\n",
+            trace, policy_name, cpus, result->procs, result->events,
+            result->load_seconds * 1e3, result->run_seconds * 1e3, events_per_sec, ns_per_event,
+            result->peak_rss_kb, result->allocs, result->alloc_bytes);
+}
+
+
+static void usage(const char* program) {
+  fprintf(stderr, "Usage: %s [options] trace...\n"
+          "  --policy P[,P...]  policies to time (default rr,stcf,stride,lottery,mlfq,cfs)\n"
+          "  --cpus N           simulate N cpus (default 1)\n"
+          "  --output FILE      write the results to FILE (default stdout):\n"
+          "                     JSON if FILE ends in .json, otherwise CSV\n"
+          "A summary of each run also goes to stderr as it finishes.  Built-in policies: ",
+          program);
+  print_policies(stderr);
+}
+
+
+int main(int argc, char** argv) {
+  static const struct option long_options[] = {
+    {"policy", required_argument, NULL, 'p'},
+    {"cpus", required_argument, NULL, 'c'},
+    {"output", required_argument, NULL, 'o'},
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
+  };
+  struct sim_options options = {.num_cpus = 1, .work_stealing = TRUE, .quiet = TRUE};
+  const char* policy_names = "rr,stcf,stride,lottery,mlfq,cfs";
+  const char* output = NULL;
+
+  int opt;
+  unsigned long value;
+  while (-1 != (opt = getopt_long(argc, argv, "p:o:h", long_options, NULL))) {
+    switch (opt) {
+    case 'p':
+      policy_names = optarg;
+      break;
+    case 'c':
+      if (parse_count(optarg, "number of cpus", 1, 65536, &value))
+        return EXIT_FAILURE;
+      options.num_cpus = value;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    default:
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const struct sched_policy** policies = NULL;
+  int num_policies = find_policies(policy_names, &policies);
+  if (num_policies < 0) {
+    unload_policies();
+    return EXIT_FAILURE;
+  }
+  FILE* out = (NULL == output) ? stdout : fopen(output, "w");
+  if (NULL == out) {
+    perror("ERROR opening output file");
+    free(policies);
+    unload_policies();
+    return EXIT_FAILURE;
+  }
+  size_t name_len = (NULL == output) ? 0 : strlen(output);
+  int json = name_len >= 5 && 0 == strcmp(&output[name_len - 5], ".json");
+
+  int status = EXIT_SUCCESS;
+  int first = 1;
+  write_header(out, json);
+  for (int arg = optind; arg < argc; ++arg) {
+    for (int i = 0; i < num_policies; ++i) {
+      struct bench_result result;
+      if (0 != bench_one(argv[arg], policies[i], &options, &result)) {
+        fprintf(stderr, "%-8s %s: FAILED\n", policies[i]->name, argv[arg]);
+        status = EXIT_FAILURE;
+        continue;
+      }
+      fprintf(stderr, "%-8s %s: %u procs, %lu events in %.3f ms, %.2f ns/event, %ld KB peak, %lu allocs\n",
+              policies[i]->name, argv[arg], result.procs, result.events, result.run_seconds * 1e3,
+              (result.events > 0) ? result.run_seconds * 1e9 / result.events : 0.0,
+              result.peak_rss_kb, result.allocs);
+      write_result(out, json, first, argv[arg], policies[i]->name, options.num_cpus, &result);
+      first = 0;
+    }
+  }
+  if (json)
+    fprintf(out, "%s]\n", first ? "" : "\n");
+
+  if (0 != fclose(out)) {
+    perror("ERROR writing output file");
+    status = EXIT_FAILURE;
+  }
+  free(policies);
+  unload_policies();
+  return status;
+}
@@ -1,413 +1,864 @@
-#include "scheduler.h"
+#include "simulation.h"
 #include "event_queue.h"
+#include "loader.h"
+#include "output.h"
+#include "metrics.h"
+#include "sim_stats.h"
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdint.h>
+
+struct cpu {
+  const struct process* running; // NULL while the cpu is idle
+  time_ticks_t time_started;     // when running's remaining_time was last updated
+  time_ticks_t slice;            // time slice running was dispatched with; 0 for none
+};
+
+/* What a run charges for switching, as cpu time added to the burst of the
+ * process switched to.  Nothing is charged by default. */
+struct switch_costs {
+  time_ticks_t migration; // when the process last ran on another cpu
+  time_ticks_t per_switch;
+  time_ticks_t decision;  // per scheduler hook call, and again per process waiting in the queue it decided from
+};
+
+/* Everything one simulation owns.  Nothing in the engine is shared between
+ * simulations, so any number of them may exist at once, stepped from one
+ * thread or run on several. */
+struct simulation {
+  struct trace trace; // the loaded .proc file; owns every process and burst
+  struct process* process_list; // contiguous process table; array index = pid
+  unsigned int total_procs;     // number of entries in process_list
+  unsigned int num_procs;       // number of processes NOT in the TERMINATED state
+  unsigned int num_ready;       // number of processes in the READY state, running or not
+  time_ticks_t current_time;
+  unsigned long events_handled; // by sim_step() since the run started
+
+  time_ticks_t initial_time_slice; // from the trace
+  time_ticks_t time_slice;         // 0 unless the policy uses time slices
+
+  struct cpu* cpus;
+  unsigned int num_cpus;
+  struct switch_costs costs;
+  bool_t work_stealing;
+  unsigned long seed;
+
+  const struct sched_policy* policy; // the policy being simulated, or NULL between runs
+  void* sched_data;                  // owned by the policy; see set_sched_data()
+  const char* metrics_file;          // written by sim_finish(), or NULL
+
+  struct event_queue events;
+  struct evt* timer_event; // the pending TIMER event, or NULL
+  struct output output;
+  struct metrics metrics;
+#ifdef SIM_STATS
+  struct sim_stats stats;
+#endif
+};
+
+/* Calls a scheduler hook; a SIM_STATS build also times it. */
+#ifdef SIM_STATS
+#define CALL_HOOK(sim, hook_id, hook, ...) do { \
+    uint64_t hook_start = stats_clock(); \
+    (sim)->policy->hook(__VA_ARGS__); \
+    stats_hook(&(sim)->stats, hook_id, stats_clock() - hook_start); \
+  } while (0)
+#else
+#define CALL_HOOK(sim, hook_id, hook, ...) (sim)->policy->hook(__VA_ARGS__)
+#endif
+
+/* A copy of everything a run has changed, taken part way through.  The
+ * bursts are not copied: they belong to the trace, which never changes. */
+struct sim_snapshot {
+  const struct sched_policy* policy;
+  void* sched_data; // from policy->sched_clone()
+
+  const struct process* process_list; // identifies the simulation it came from
+  struct process* procs;              // copy of every process
+  unsigned int total_procs;
+  unsigned int num_procs;
+  unsigned int num_ready;
+  time_ticks_t current_time;
+  unsigned long events_handled;
+  time_ticks_t initial_time_slice;
+  time_ticks_t time_slice;
+
+  struct cpu* cpus;
+  unsigned int num_cpus;
+
+  struct evt* events;           // the event heap, in heap order
+  unsigned char* is_cpu_event;  // per event: it is its process' cpu_event
+  size_t num_events;
+  size_t timer_index;           // of the pending TIMER event, or num_events if none
+  unsigned long next_seq;
+
+  struct metrics metrics;
+};
+
+
+unsigned int get_num_cpus(sim_t* sim) {
+  return sim->num_cpus;
+}
 
-// whitespace characters to use as a delimiter
-#define WHITESPACE_DELIM " \t\r\n"
 
-static time_ticks_t INITIAL_TIME_SLICE = 0;
-static time_ticks_t TIME_SLICE = 0;
+unsigned int get_num_procs(sim_t* sim) {
+  return sim->total_procs;
+}
 
-static struct process** process_list = NULL; // array of pointers to processes; array index = pid
-static unsigned int num_procs = 0; // number of processes NOT in the TERMINATED state
 
-time_ticks_t current_time = 0;
-time_ticks_t time_started = 0;
-static const struct process* currently_running = NULL;
+unsigned long get_seed(sim_t* sim) {
+  return sim->seed;
+}
 
 
-pid_t get_current_proc() {
-  if (NULL == currently_running)
+pid_t get_current_proc_on(sim_t* sim, int cpu) {
+  if (cpu < 0 || (unsigned int)cpu >= sim->num_cpus || NULL == sim->cpus[cpu].running)
     return -1;
   else
-    return currently_running->pid;
+    return sim->cpus[cpu].running->pid;
+}
+
+
+void* get_sched_data(sim_t* sim) {
+  return sim->sched_data;
+}
+
+
+void set_sched_data(sim_t* sim, void* data) {
+  sim->sched_data = data;
+}
+
+
+pid_t get_current_proc(sim_t* sim) {
+  return get_current_proc_on(sim, 0);
+}
+
+
+int get_proc_cpu(sim_t* sim, pid_t pid) {
+  if (pid < 0 || (unsigned int)pid >= sim->total_procs)
+    return -1;
+  return sim->process_list[pid].cpu;
+}
+
+
+bool_t get_work_stealing(sim_t* sim) {
+  return sim->work_stealing && sim->num_cpus > 1;
+}
+
+
+void record_steal(sim_t* sim, pid_t pid, int from_cpu, int to_cpu) {
+  assert(from_cpu != to_cpu);
+  (void)pid;
+  (void)from_cpu;
+  (void)to_cpu;
+  metrics_stolen(&sim->metrics);
+}
+
+
+time_ticks_t get_current_time(sim_t* sim) {
+  return sim->current_time;
 }
 
 
-time_ticks_t get_time_slice() {
-  return TIME_SLICE;
+time_ticks_t get_time_slice(sim_t* sim) {
+  return sim->time_slice;
 }
 
-void use_time_slice(bool_t use) {
+void use_time_slice(sim_t* sim, bool_t use) {
   if (use)
-    TIME_SLICE = INITIAL_TIME_SLICE;
+    sim->time_slice = sim->initial_time_slice;
   else
-    TIME_SLICE = 0;
+    sim->time_slice = 0;
+}
+
+
+void set_time_slice(sim_t* sim, time_ticks_t ticks) {
+  sim->time_slice = ticks;
+}
+
+
+void set_timer(sim_t* sim, time_ticks_t delay) {
+  assert(delay > 0);
+  if (NULL != sim->timer_event)
+    cancel_event(sim->timer_event);
+  sim->timer_event = new_event(&sim->events, sim->current_time + delay, TIMER, NULL);
 }
 
 
-void print_process_list() {
+void print_process_list(sim_t* sim) {
   fprintf(stderr, "\nPROCESS LIST\n");
-  unsigned int pid = 0;
-  for (const struct process* next_proc = process_list[pid];
-       NULL != next_proc;
-       next_proc = process_list[++pid]) {
-    print_process(next_proc);
+  for (unsigned int pid = 0; pid < sim->total_procs; ++pid) {
+    print_process(&sim->process_list[pid]);
     fprintf(stderr, "\n");
   }
 }
 
 
-void terminate_process(struct process* proc) {
-  proc->state = TERMINATED;
-  --num_procs;
+// changes proc's state, keeping count of the READY processes
+static void set_state(sim_t* sim, struct process* proc, state_t state) {
+  if (READY == proc->state)
+    --sim->num_ready;
+  if (READY == state)
+    ++sim->num_ready;
+  proc->state = state;
 }
 
 
-void finish_burst(struct process* proc) {
-  struct burst* old_burst = proc->current_burst;
-  if (NULL != old_burst) {
-    proc->current_burst = old_burst->next_burst;
-    free(old_burst);
+static void terminate_process(sim_t* sim, struct process* proc) {
+  set_state(sim, proc, TERMINATED);
+  --sim->num_procs;
+  metrics_terminated(&sim->metrics, proc->pid, sim->current_time);
+}
+
+
+static void finish_burst(sim_t* sim, struct process* proc) {
+  if (proc_has_burst(proc))
+    ++proc->burst_index;
+
+  if (!proc_has_burst(proc)) {
+    proc->remaining_time = 0;
+    terminate_process(sim, proc);
+    return;
   }
 
-  if (NULL == proc->current_burst) {
-    terminate_process(proc);
-  } else if (CPU_BURST == proc->current_burst->type)
-    proc->state = READY;
-  else if (IO_BURST == proc->current_burst->type)
-    proc->state = BLOCKED;
+  proc->remaining_time = proc->bursts[proc->burst_index];
+  if (CPU_BURST == proc_burst_type(proc))
+    set_state(sim, proc, READY);
+  else
+    set_state(sim, proc, BLOCKED);
 }
 
 
-time_ticks_t deduct_burst(struct process* proc, time_ticks_t amount) {
-  if (NULL == proc->current_burst) {
+static time_ticks_t deduct_burst(sim_t* sim, struct process* proc, time_ticks_t amount) {
+  if (!proc_has_burst(proc)) {
     if (TERMINATED != proc->state) {
       fprintf(stderr,
               "WARNING: Process %d is in state %d, despite having no remaining bursts! Changing state to TERMINATED.\n",
               proc->pid, proc->state);
-      terminate_process(proc);
+      terminate_process(sim, proc);
     }
     return 0;
   }
-  // INVARIANT: proc->current_burst is valid
+  // INVARIANT: proc has a current burst
 
-  if (amount >= proc->current_burst->remaining_time) {
-    finish_burst(proc);
+  if (amount >= proc->remaining_time) {
+    finish_burst(sim, proc);
     return 0;
   } else {
-    proc->current_burst->remaining_time -= amount;
-    assert(proc->current_burst->remaining_time > 0);
-    return proc->current_burst->remaining_time;
+    proc->remaining_time -= amount;
+    assert(proc->remaining_time > 0);
+    return proc->remaining_time;
   }
 }
 
 
-void end_cpu_event() {
-  // set up next event on this proc (FINISH_CPU or FINISH_TIME_SLICE)
-  assert(CPU_BURST == currently_running->current_burst->type);
-  time_ticks_t run_for_time = currently_running->current_burst->remaining_time;
+// overhead is how much of the burst is switching costs, paid before the slice starts
+static void end_cpu_event(sim_t* sim, unsigned int cpu, time_ticks_t overhead) {
+  // set up next event on this cpu's proc (FINISH_CPU or FINISH_TIME_SLICE)
+  struct process* proc = &sim->process_list[sim->cpus[cpu].running->pid];
+  assert(CPU_BURST == proc_burst_type(proc));
+  time_ticks_t run_for_time = proc->remaining_time;
   event_type_t event_type = FINISH_CPU;
 
-  if (get_time_slice() > 0 && get_time_slice() < run_for_time) {
-    run_for_time = get_time_slice();
+  if (sim->cpus[cpu].slice > 0 && sim->cpus[cpu].slice < run_for_time - overhead) {
+    run_for_time = overhead + sim->cpus[cpu].slice;
     event_type = FINISH_TIME_SLICE;
   }
 
-  new_event(current_time + run_for_time, event_type, process_list[currently_running->pid]);
+  proc->cpu_event = new_event(&sim->events, sim->current_time + run_for_time, event_type, proc);
 }
 
 
-int context_switch(pid_t pid) {
+// returns 0 if the process pid may be switched to on cpu, or -1 after warning why not
+static int check_switch(sim_t* sim, int cpu, pid_t pid) {
+  if (cpu < 0 || (unsigned int)cpu >= sim->num_cpus) {
+    output_printf(&sim->output, "WARNING: invalid cpu value %d\n", cpu);
+    return -1;
+  }
   if(pid < 0) {
-    printf("WARNING: invalid pid value %d\n", pid);
+    output_printf(&sim->output, "WARNING: invalid pid value %d\n", pid);
+    return -1;
+  }
+  if ((unsigned int)pid >= sim->total_procs) {
+    output_printf(&sim->output, "WARNING: invalid pid value %d\n", pid);
     return -1;
   }
-  if (READY != process_list[pid]->state) {
-    printf("WARNING: process %d is not in the READY state\n", pid);
+  const struct process* proc = &sim->process_list[pid];
+  if (READY != proc->state) {
+    output_printf(&sim->output, "WARNING: process %d is not in the READY state\n", pid);
     return -1;
   }
+  const struct process* currently_running = sim->cpus[cpu].running;
   if (NULL != currently_running && currently_running->pid == pid) {
-    printf("WARNING: attempt to context switch to currently running process (pid=%d)\n", pid);
+    output_printf(&sim->output, "WARNING: attempt to context switch to currently running process (pid=%d)\n", pid);
     return -1;
   }
-  // INVARIANTS: pid is valid, not the currently_running process, and the process is able to run
+  if (proc->cpu >= 0 && sim->cpus[proc->cpu].running == proc) {
+    output_printf(&sim->output, "WARNING: process %d is already running on cpu %d\n", pid, proc->cpu);
+    return -1;
+  }
+  return 0;
+}
+
 
-  if (NULL != currently_running && READY == currently_running->state) {
-    remove_events(currently_running->pid); // remove the FINISH_CPU or FINISH_TIME_SLICE event
+int context_switch_on_with_slice(sim_t* sim, int cpu, pid_t pid, time_ticks_t slice) {
+  SIM_STAT(++sim->stats.context_switches);
+  if (0 != check_switch(sim, cpu, pid)) {
+    SIM_STAT(++sim->stats.context_switch_failures);
+    return -1;
+  }
+  struct process* proc = &sim->process_list[pid];
+  const struct process* currently_running = sim->cpus[cpu].running;
+  // INVARIANTS: cpu and pid are valid, pid is not running anywhere, and the process is able to run
+
+  if (NULL != currently_running && READY == currently_running->state
+      && NULL != currently_running->cpu_event) {
+    // cancel the pending FINISH_CPU or FINISH_TIME_SLICE event
+    // (there is none if we are switching away because that event just fired)
+    struct process* prev_proc = &sim->process_list[currently_running->pid];
+    cancel_event(prev_proc->cpu_event);
+    prev_proc->cpu_event = NULL;
+  }
+  if (NULL != currently_running && READY == currently_running->state)
+    metrics_preempted(&sim->metrics, currently_running->pid, sim->current_time);
+  time_ticks_t overhead = 0;
+  if (proc->cpu >= 0 && proc->cpu != cpu) {
+    // the process lost its cache affinity; charge the refill to its cpu burst
+    overhead += sim->costs.migration;
+    metrics_migrated(&sim->metrics, pid, sim->costs.migration);
   }
+  if (sim->costs.per_switch > 0) {
+    overhead += sim->costs.per_switch;
+    metrics_charged(&sim->metrics, sim->costs.per_switch, 0);
+  }
+  proc->remaining_time += overhead;
+
+  sim->cpus[cpu].running = proc;
+  sim->cpus[cpu].time_started = sim->current_time;
+  sim->cpus[cpu].slice = slice;
+  proc->cpu = cpu;
+  output_event(&sim->output, OUT_RUNNING, sim->current_time, pid, cpu);
+  metrics_dispatched(&sim->metrics, pid, cpu, sim->current_time);
+  end_cpu_event(sim, cpu, overhead);
+  return 0;
+}
+
+
+int context_switch_on(sim_t* sim, int cpu, pid_t pid) {
+  return context_switch_on_with_slice(sim, cpu, pid, sim->time_slice);
+}
+
 
-  currently_running = process_list[pid];
-  time_started = current_time;
-  printf("(t=%d) running proc %d\n", current_time, currently_running->pid);
-  end_cpu_event();
+int context_switch_with_slice(sim_t* sim, pid_t pid, time_ticks_t slice) {
+  return context_switch_on_with_slice(sim, 0, pid, slice);
+}
+
+
+int rearm_time_slice(sim_t* sim, int cpu, time_ticks_t slice) {
+  if (cpu < 0 || (unsigned int)cpu >= sim->num_cpus) {
+    output_printf(&sim->output, "WARNING: invalid cpu value %d\n", cpu);
+    return -1;
+  }
+  const struct process* running = sim->cpus[cpu].running;
+  if (NULL == running || READY != running->state) {
+    output_printf(&sim->output, "WARNING: no process is running on cpu %d\n", cpu);
+    return -1;
+  }
+  // remaining_time is already up to date: every cpu is brought up to
+  // current_time before an event is handled
+  struct process* proc = &sim->process_list[running->pid];
+  if (NULL != proc->cpu_event) {
+    cancel_event(proc->cpu_event);
+    proc->cpu_event = NULL;
+  }
+  sim->cpus[cpu].slice = slice;
+  end_cpu_event(sim, cpu, 0);
   return 0;
 }
 
-time_ticks_t event_loop() {
-  for (const struct evt* event = pop_next_event();
-       NULL != event && num_procs > 0;
-       event = pop_next_event()) {
+
+int context_switch(sim_t* sim, pid_t pid) {
+  return context_switch_on(sim, 0, pid);
+}
+
+
+// the number of READY processes not running on any cpu
+static unsigned int waiting_procs(const sim_t* sim) {
+  unsigned int waiting = sim->num_ready;
+  for (unsigned int cpu = 0; cpu < sim->num_cpus; ++cpu) {
+    if (NULL != sim->cpus[cpu].running && READY == sim->cpus[cpu].running->state)
+      --waiting;
+  }
+  return waiting;
+}
+
+
+// charges the decision a hook just made for cpu to whatever cpu now runs:
+// --decision-cost for the decision itself and again for every process still
+// waiting in the queue it decided from.  The charge is cpu time, so the
+// running process' pending event moves back by it; a cpu left idle has
+// nobody waiting for the decision and is not charged.
+static void charge_decision(sim_t* sim, int cpu) {
+  const struct process* running = sim->cpus[cpu].running;
+  if (NULL == running || READY != running->state || NULL == running->cpu_event)
+    return;
+  unsigned int waiting = (NULL != sim->policy->sched_queue_length)
+                         ? sim->policy->sched_queue_length(sim, cpu) : waiting_procs(sim);
+  if (waiting > sim->total_procs)
+    waiting = sim->total_procs; // check_costs() allows for no more than this
+  time_ticks_t cost = sim->costs.decision * (1 + waiting);
+
+  struct process* proc = &sim->process_list[running->pid];
+  time_ticks_t time = proc->cpu_event->time + cost;
+  event_type_t type = proc->cpu_event->type;
+  cancel_event(proc->cpu_event);
+  proc->remaining_time += cost;
+  proc->cpu_event = new_event(&sim->events, time, type, proc);
+  metrics_charged(&sim->metrics, 0, cost);
+}
+
+bool_t sim_step(sim_t* sim) {
+  assert(NULL != sim->policy);
+  if (0 == sim->num_procs)
+    return FALSE;
+  const struct evt* event = pop_next_event(&sim->events);
+  if (NULL == event)
+    return FALSE;
+  ++sim->events_handled;
+#ifdef SIM_STATS
+  uint64_t step_start = stats_clock();
+  if (event->type < NUM_EVENT_TYPES)
+    ++sim->stats.events[event->type];
+#endif // SIM_STATS
 
 #ifdef DEBUG
-    fprintf(stderr, "Handling Event: ");
-    print_event(event);
+  fprintf(stderr, "Handling Event: ");
+  print_event(event);
 #endif // DEBUG
 
-    current_time = event->time;
-    // update remaining_time on the currently_running process (ending the current burst, if it has finished)
-    if (current_time > time_started && NULL != currently_running) {
-      deduct_burst(process_list[currently_running->pid], current_time - time_started);
-      time_started = current_time;
+  sim->current_time = event->time;
+  if (event == sim->timer_event)
+    sim->timer_event = NULL;
+  else if (event == event->proc->cpu_event)
+    event->proc->cpu_event = NULL; // this CPU event is no longer pending
+  // update remaining_time on every running process (ending the current burst, if it has finished)
+  for (unsigned int cpu = 0; cpu < sim->num_cpus; ++cpu) {
+    if (sim->current_time > sim->cpus[cpu].time_started && NULL != sim->cpus[cpu].running) {
+      deduct_burst(sim, &sim->process_list[sim->cpus[cpu].running->pid], sim->current_time - sim->cpus[cpu].time_started);
+      sim->cpus[cpu].time_started = sim->current_time;
     }
+  }
 
-    switch (event->type) {
+  switch (event->type) {
+
+  case ARRIVAL:
+    assert(CPU_BURST == proc_burst_type(event->proc));
+    set_state(sim, event->proc, READY);
+    output_event(&sim->output, OUT_ARRIVED, sim->current_time, event->proc->pid, event->proc->cpu);
+    metrics_arrived(&sim->metrics, event->proc->pid, sim->current_time);
+    CALL_HOOK(sim, HOOK_NEW_PROCESS, sched_new_process, sim, event->proc);
+    break;
+
+  case FINISH_TIME_SLICE:
+    assert(CPU_BURST == proc_burst_type(event->proc));
+    assert(READY == event->proc->state);
+    if (TERMINATED == event->proc->state) {
+      assert(!proc_has_burst(event->proc));
+      CALL_HOOK(sim, HOOK_TERMINATED, sched_terminated, sim, event->proc);
+    } else {
+      assert(CPU_BURST == proc_burst_type(event->proc));
+      assert(READY == event->proc->state);
+      unsigned int cpu = event->proc->cpu;
+      CALL_HOOK(sim, HOOK_FINISHED_TIME_SLICE, sched_finished_time_slice, sim, event->proc);
+      // continuing same proc after time slice requires new time slice event,
+      // unless the policy has already re-armed it
+      if (sim->cpus[cpu].running == event->proc && NULL == event->proc->cpu_event)
+        end_cpu_event(sim, cpu, 0);
+    }
+    break;
 
-    case ARRIVAL:
-      assert(CPU_BURST == event->proc->current_burst->type);
-      event->proc->state = READY;
-      printf("(t=%d) proc %d arrived\n", current_time, event->proc->pid);
-      sched_new_process(event->proc);
-      break;
+  case FINISH_CPU:
+    if (TERMINATED == event->proc->state) {
+      assert(!proc_has_burst(event->proc));
+      CALL_HOOK(sim, HOOK_TERMINATED, sched_terminated, sim, event->proc);
 
-    case FINISH_TIME_SLICE:
-      assert(CPU_BURST == event->proc->current_burst->type);
-      assert(READY == event->proc->state);
-      if (TERMINATED == event->proc->state) {
-        assert(NULL == event->proc->current_burst);
-        sched_terminated(event->proc);
-      } else {
-        assert(CPU_BURST == event->proc->current_burst->type);
-        assert(READY == event->proc->state);
-        pid_t prev_proc = currently_running->pid;
-        sched_finished_time_slice(event->proc);
-        if (prev_proc == currently_running->pid)
-          end_cpu_event(); // continuing same proc after time slice requires new time slice event
-      }
-      break;
-
-    case FINISH_CPU:
-      if (TERMINATED == event->proc->state) {
-        assert(NULL == event->proc->current_burst);
-        sched_terminated(event->proc);
-
-      } else {
-        assert(IO_BURST == event->proc->current_burst->type);
-        assert(BLOCKED == event->proc->state);
-        new_event(current_time + event->proc->current_burst->remaining_time,
-                  FINISH_IO,
-                  event->proc);
-        printf("(t=%d) proc %d blocked for I/O\n", current_time, event->proc->pid);
-        sched_blocked(event->proc);
-      }
-      break;
-
-    case FINISH_IO:
-      assert(IO_BURST == event->proc->current_burst->type);
+    } else {
+      assert(IO_BURST == proc_burst_type(event->proc));
       assert(BLOCKED == event->proc->state);
-      finish_burst(event->proc);
-
-      if (TERMINATED == event->proc->state) {
-        assert(NULL == event->proc->current_burst);
-        sched_terminated(event->proc);
-
-      } else {
-        // proc should not be TERMINATED immediately after
-        // finishing an I/O burst (only after a CPU burst)
-        assert(CPU_BURST == event->proc->current_burst->type);
-        assert(READY == event->proc->state);
-        printf("(t=%d) proc %d finished I/O\n", current_time, event->proc->pid);
-        sched_unblocked(event->proc);
-      }
-      break;
-
-    default:
-      fprintf(stderr, "ERROR: Unrecognized event type %d at time %u; ignoring event...\n", event->type, event->time);
+      new_event(&sim->events, sim->current_time + event->proc->remaining_time,
+                FINISH_IO,
+                event->proc);
+      output_event(&sim->output, OUT_BLOCKED, sim->current_time, event->proc->pid, event->proc->cpu);
+      CALL_HOOK(sim, HOOK_BLOCKED, sched_blocked, sim, event->proc);
     }
-    free((void*)event);
-    event = NULL;
+    break;
+
+  case FINISH_IO:
+    assert(IO_BURST == proc_burst_type(event->proc));
+    assert(BLOCKED == event->proc->state);
+    finish_burst(sim, event->proc);
 
-    if (NULL != currently_running && READY != currently_running->state) {
-        printf("(t=%d) idle\n", current_time);
-        currently_running = NULL;
+    if (TERMINATED == event->proc->state) {
+      assert(!proc_has_burst(event->proc));
+      CALL_HOOK(sim, HOOK_TERMINATED, sched_terminated, sim, event->proc);
+
+    } else {
+      // proc should not be TERMINATED immediately after
+      // finishing an I/O burst (only after a CPU burst)
+      assert(CPU_BURST == proc_burst_type(event->proc));
+      assert(READY == event->proc->state);
+      output_event(&sim->output, OUT_FINISHED_IO, sim->current_time, event->proc->pid, event->proc->cpu);
+      metrics_unblocked(&sim->metrics, event->proc->pid, sim->current_time);
+      CALL_HOOK(sim, HOOK_UNBLOCKED, sched_unblocked, sim, event->proc);
     }
+    break;
+
+  case TIMER:
+    if (NULL != sim->policy->sched_timer)
+      CALL_HOOK(sim, HOOK_TIMER, sched_timer, sim);
+    break;
+
+  default:
+    fprintf(stderr, "ERROR: Unrecognized event type %d at time %u; ignoring event...\n", event->type, event->time);
   }
-  // INVARIANT: all processes are TERMINATED state AND event loop is empty
-  return current_time;
-}
-
-void load_file(const char* filename) {
-  char line[1024];
-  FILE* file = fopen(filename, "r");
-  if (NULL == file) {
-    perror("ERROR opening file");
-    exit(EXIT_FAILURE);
-  }
-  
-  // Get the TIME_SLICE value
-  if (NULL == fgets(line, 1024, file)) {
-    perror("ERROR reading file");
-    fclose(file);
-    exit(EXIT_FAILURE);
-  }
-  size_t first_digit = strcspn(line, "1234567890");
-  char* token = &line[first_digit];
-  size_t after_last_digit = strspn(line, "1234567890");
-  line[after_last_digit] = '\0';
-  char* endptr = NULL;
-  TIME_SLICE = INITIAL_TIME_SLICE = strtoul(token, &endptr, 10);
-  if ('\0' != *endptr) {
-    perror("ERROR in file contents");
-    fprintf(stderr, "Failed to convert string \"%s\" to TIME_SLICE value\n", token);
-    fclose(file);
-    exit(EXIT_FAILURE);
-  }
-
-  // Get the number of processes
-  if (NULL == fgets(line, 1024, file)) {
-    perror("ERROR reading file");
-    fclose(file);
-    exit(EXIT_FAILURE);
-  }
-  first_digit = strcspn(line, "1234567890");
-  token = &line[first_digit];
-  after_last_digit = strspn(line, "1234567890");
-  line[after_last_digit] = '\0';
-  endptr = NULL;
-  num_procs = strtoul(token, &endptr, 10);
-  if ('\0' != *endptr) {
-    perror("ERROR in file contents");
-    fprintf(stderr, "Failed to convert string \"%s\" to NUM_PROCS value\n", token);
-    fclose(file);
-    exit(EXIT_FAILURE);
-  }
-
-  // Load the processes
-  process_list = malloc((num_procs + 1) * sizeof(struct process*));
-  memset(process_list, 0, (num_procs + 1) * sizeof(struct process*));
-
-  for (unsigned int pid = 0; pid < num_procs; ++pid) {
-    process_list[pid] = malloc(sizeof(struct process));
-    memset(process_list[pid], 0, sizeof(struct process));
-    process_list[pid]->pid = pid;
-    process_list[pid]->state = NOT_ARRIVED;
-
-    if (NULL == fgets(line, 1024, file)) {
-      perror("ERROR reading file");
-      fclose(file);
-      exit(EXIT_FAILURE);
+  // the hook decided for the cpu its process is on (or was last on); one
+  // with no such cpu, a TIMER or a process only queued so far, is charged
+  // to cpu 0
+  if (sim->costs.decision > 0 && (TIMER != event->type || NULL != sim->policy->sched_timer))
+    charge_decision(sim, (NULL != event->proc && event->proc->cpu >= 0) ? event->proc->cpu : 0);
+  free_event(&sim->events, event);
+  event = NULL;
+
+  for (unsigned int cpu = 0; cpu < sim->num_cpus; ++cpu) {
+    if (NULL != sim->cpus[cpu].running && READY != sim->cpus[cpu].running->state) {
+      output_event(&sim->output, OUT_IDLE, sim->current_time, -1, cpu);
+      metrics_idle(&sim->metrics, cpu, sim->current_time);
+      sim->cpus[cpu].running = NULL;
     }
+  }
+  SIM_STAT(sim->stats.step_ns += stats_clock() - step_start);
+  return TRUE;
+}
 
-    token = strtok(line, WHITESPACE_DELIM);
-    if (NULL == token) {
-      perror("ERROR in file contents");
-      fprintf(stderr, "No number of tickets found on process line: %s\n", line);
-      fclose(file);
-      exit(EXIT_FAILURE);
-    }
-    endptr = NULL;
-    process_list[pid]->tickets = strtoul(token, &endptr, 10);
-    if ('\0' != *endptr) {
-      perror("ERROR in file contents");
-      fprintf(stderr, "Failed to convert string \"%s\" to number of tickets\n", token);
-      fclose(file);
-      exit(EXIT_FAILURE);
-    }
+sim_t* sim_create() {
+  sim_t* sim = calloc(1, sizeof(struct simulation));
+  assert(NULL != sim);
+  return sim;
+}
 
-    token = strtok(NULL, WHITESPACE_DELIM);
-    if (NULL == token) {
-      perror("ERROR in file contents");
-      fprintf(stderr, "No arrival time found on process line: %s\n", line);
-      fclose(file);
-      exit(EXIT_FAILURE);
-    }
-    endptr = NULL;
-    process_list[pid]->arrival_time = strtoul(token, &endptr, 10);
-    if ('\0' != *endptr) {
-      perror("ERROR in file contents");
-      fprintf(stderr, "Failed to convert string \"%s\" to arrival time\n", token);
-      fclose(file);
-      exit(EXIT_FAILURE);
-    }
 
-    // the list of bursts starts as a CPU burst,
-    // and then alternates between CPU and I/O bursts
-    burst_type_t burst_type = CPU_BURST;
-    struct burst** next_burst_ptr = &process_list[pid]->current_burst;
-    token = strtok(NULL, WHITESPACE_DELIM);
-
-    while (NULL != token) {
-      // create burst
-      struct burst* next_burst = malloc(sizeof(struct burst));
-      memset(next_burst, 0, sizeof(struct burst));
-
-      // populate burst info
-      next_burst->type = burst_type;
-      endptr = NULL;
-      next_burst->remaining_time = strtoul(token, &endptr, 10);
-      if ('\0' != *endptr) {
-        perror("ERROR in file contents");
-        fprintf(stderr, "Failed to convert string \"%s\" to burst time\n", token);
-        fclose(file);
-        exit(EXIT_FAILURE);
-      }
-
-      // point to burst, then update next pointer
-      *next_burst_ptr = next_burst;
-      next_burst_ptr = &next_burst->next_burst;
-
-      // change burst type for next burst
-      if (CPU_BURST == burst_type)
-        burst_type = IO_BURST;
-      else
-        burst_type = CPU_BURST;
-
-      // get the next burst time token
-      token = strtok(NULL, WHITESPACE_DELIM);
-    }
+int sim_load(sim_t* sim, const char* filename, bool_t report_stats) {
+  assert(NULL == sim->policy);
+  // processes, bursts and process_list itself all live in the trace's arena
+  release_trace(&sim->trace);
+  sim->process_list = NULL;
+  sim->total_procs = 0;
+  if (0 != load_trace(filename, &sim->trace))
+    return -1;
+  if (report_stats)
+    print_load_stats(filename, &sim->trace);
+
+  sim->initial_time_slice = sim->trace.time_slice;
+  sim->process_list = sim->trace.procs;
+  sim->total_procs = sim->trace.num_procs;
+  return 0;
+}
 
-    new_event(process_list[pid]->arrival_time, ARRIVAL, process_list[pid]);
+
+unsigned int sim_num_procs(const sim_t* sim) {
+  return sim->total_procs;
+}
+
+
+// returns 0 if no context switch or scheduling decision in the loaded trace
+// can charge more than SIM_MAX_SWITCH_CHARGE, or -1 after printing why not
+static int check_costs(const sim_t* sim, const struct sim_options* options) {
+  uint64_t most = (uint64_t)options->decision_cost * (sim->total_procs + 1) + options->switch_cost
+                  + options->migration_cost;
+  if (most > SIM_MAX_SWITCH_CHARGE) {
+    fprintf(stderr, "ERROR: switching costs could add up to %llu ticks at once; the most allowed is %u\n",
+            (unsigned long long)most, SIM_MAX_SWITCH_CHARGE);
+    return -1;
   }
+  return 0;
+}
+
+
+static void set_costs(sim_t* sim, const struct sim_options* options) {
+  sim->costs.migration = options->migration_cost;
+  sim->costs.per_switch = options->switch_cost;
+  sim->costs.decision = options->decision_cost;
+}
 
-  fclose(file);
+
+// puts the loaded trace and the simulated cpus back in their initial state
+static void start_simulation(sim_t* sim, const struct sim_options* options) {
+  reset_trace(&sim->trace);
+  sim->time_slice = sim->initial_time_slice;
+  sim->num_procs = sim->total_procs;
+  sim->current_time = 0;
+  sim->events_handled = 0;
+  sim->num_cpus = options->num_cpus;
+  sim->num_ready = 0;
+  set_costs(sim, options);
+  sim->work_stealing = options->work_stealing;
+  sim->seed = options->seed;
+  sim->sched_data = NULL;
+  sim->timer_event = NULL;
+#ifdef SIM_STATS
+  memset(&sim->stats, 0, sizeof(struct sim_stats));
+  memset(&sim->events.stats, 0, sizeof(struct queue_stats));
+#endif
+
+  sim->cpus = calloc(sim->num_cpus, sizeof(struct cpu));
+  assert(NULL != sim->cpus);
+  metrics_init(&sim->metrics, sim->total_procs, sim->num_cpus);
+  for (unsigned int pid = 0; pid < sim->total_procs; ++pid) {
+    new_event(&sim->events, sim->process_list[pid].arrival_time, ARRIVAL, &sim->process_list[pid]);
+  }
 }
 
 
-void cleanup_processes() {
-  for (unsigned int i = 0; NULL != process_list[i]; ++i) {
-    if (TERMINATED != process_list[i]->state) {
-      printf("ERROR: Finishing simulation while process %d is not TERMINATED (status=%d)\n",
-             process_list[i]->pid, process_list[i]->state);
+static void check_processes(sim_t* sim) {
+  for (unsigned int i = 0; i < sim->total_procs; ++i) {
+    const struct process* proc = &sim->process_list[i];
+    if (TERMINATED != proc->state) {
+      output_printf(&sim->output, "ERROR: Finishing simulation while process %d is not TERMINATED (status=%d)\n",
+             proc->pid, proc->state);
 #ifdef DEBUG
-      print_process(process_list[i]);
+      print_process(proc);
 #endif // DEBUG
     }
 
-    struct burst* this_burst = process_list[i]->current_burst;
-    while (NULL != this_burst) {
+    for (unsigned int b = proc->burst_index; b < proc->num_bursts; ++b) {
+      time_ticks_t remaining_time = (b == proc->burst_index) ? proc->remaining_time : proc->bursts[b];
       fprintf(stderr, "WARNING: Freeing burst type %d with remaining time %d on process %d\n",
-              this_burst->type, this_burst->remaining_time, process_list[i]->pid);
-
-      struct burst* prev_burst = this_burst;
-      this_burst = this_burst->next_burst;
-      free(prev_burst);
+              b & 1, remaining_time, proc->pid);
     }
+  }
+}
+
+
+// frees everything a run allocated, after the policy has cleaned up;
+// a finished run also reports any process that did not terminate
+static void end_run(sim_t* sim, bool_t finished) {
+  CALL_HOOK(sim, HOOK_CLEANUP, sched_cleanup, sim);
+  sim->policy = NULL;
+  if (finished)
+    check_processes(sim);
+  free(sim->cpus);
+  sim->cpus = NULL;
+  cleanup_event_queue(&sim->events);
+  sim->timer_event = NULL;
+  output_close(&sim->output);
+}
+
+
+int sim_start(sim_t* sim, const struct sched_policy* policy, const struct sim_options* options, FILE* out) {
+  assert(NULL == sim->policy);
+  if (0 != check_costs(sim, options))
+    return -1;
+  if (0 != output_open(&sim->output, out, options->quiet, options->event_log, options->num_cpus > 1))
+    return -1;
+  sim->policy = policy;
+  sim->metrics_file = options->metrics_file;
+  start_simulation(sim, options);
+  CALL_HOOK(sim, HOOK_INIT, sched_init, sim);
+  return 0;
+}
 
-    free(process_list[i]);
+
+bool_t sim_step_until(sim_t* sim, time_ticks_t until, unsigned long max_events) {
+  for (unsigned long handled = 0; handled < max_events; ++handled) {
+    if (0 == sim->num_procs)
+      return FALSE;
+    const struct evt* next = peek_next_event(&sim->events);
+    if (NULL == next)
+      return FALSE;
+    if (next->time > until)
+      return TRUE;
+    sim_step(sim);
   }
-  free(process_list);
-  process_list = NULL;
+  return 0 != sim->num_procs && NULL != peek_next_event(&sim->events);
+}
+
+
+time_ticks_t sim_time(const sim_t* sim) {
+  return sim->current_time;
+}
+
+
+unsigned long sim_events(const sim_t* sim) {
+  return sim->events_handled;
+}
+
+
+void sim_set_time_slice(sim_t* sim, time_ticks_t time_slice) {
+  sim->initial_time_slice = time_slice;
+  if (sim->time_slice > 0)
+    sim->time_slice = time_slice;
 }
 
 
-int main(int argc, char** argv) {
-  if (argc <= 1) {
-    fprintf(stderr, "Usage: ./simulation filename.proc\n");
-    return EXIT_FAILURE;
+struct sim_snapshot* sim_snapshot(const sim_t* sim) {
+  assert(NULL != sim->policy);
+  if (NULL == sim->policy->sched_clone || NULL == sim->policy->sched_free) {
+    fprintf(stderr, "ERROR: policy %s does not support snapshots\n", sim->policy->name);
+    return NULL;
   }
-  load_file(argv[1]);
+  struct sim_snapshot* snapshot = malloc(sizeof(struct sim_snapshot));
+  assert(NULL != snapshot);
+  snapshot->policy = sim->policy;
+  snapshot->sched_data = sim->policy->sched_clone(sim->sched_data);
+  snapshot->process_list = sim->process_list;
+  snapshot->total_procs = sim->total_procs;
+  snapshot->procs = malloc((sim->total_procs + 1) * sizeof(struct process));
+  assert(NULL != snapshot->procs);
+  memcpy(snapshot->procs, sim->process_list, sim->total_procs * sizeof(struct process));
+  snapshot->num_procs = sim->num_procs;
+  snapshot->num_ready = sim->num_ready;
+  snapshot->current_time = sim->current_time;
+  snapshot->events_handled = sim->events_handled;
+  snapshot->initial_time_slice = sim->initial_time_slice;
+  snapshot->time_slice = sim->time_slice;
+
+  snapshot->num_cpus = sim->num_cpus;
+  snapshot->cpus = malloc(sim->num_cpus * sizeof(struct cpu));
+  assert(NULL != snapshot->cpus);
+  memcpy(snapshot->cpus, sim->cpus, sim->num_cpus * sizeof(struct cpu));
+
+  snapshot->num_events = sim->events.size;
+  snapshot->next_seq = sim->events.next_seq;
+  snapshot->events = malloc((snapshot->num_events + 1) * sizeof(struct evt));
+  snapshot->is_cpu_event = malloc(snapshot->num_events + 1);
+  assert(NULL != snapshot->events && NULL != snapshot->is_cpu_event);
+  copy_event_queue(&sim->events, snapshot->events);
+  snapshot->timer_index = snapshot->num_events;
+  for (size_t i = 0; i < snapshot->num_events; ++i) {
+    const struct evt* event = sim->events.heap[i];
+    snapshot->is_cpu_event[i] = (NULL != event->proc && event == event->proc->cpu_event);
+    if (event == sim->timer_event)
+      snapshot->timer_index = i;
+  }
+
+  metrics_copy(&snapshot->metrics, &sim->metrics);
+  return snapshot;
+}
 
-  sched_init();
-  time_ticks_t end_time = event_loop();
-  // INVARIANT: event queue should now be empty
-  printf("Finished at time %d\n", end_time);
-  sched_cleanup();
 
-  cleanup_processes();
-  return EXIT_SUCCESS;
+int sim_restore(sim_t* sim, const struct sim_snapshot* snapshot, const struct sim_options* options, FILE* out) {
+  if (snapshot->process_list != sim->process_list || snapshot->total_procs != sim->total_procs) {
+    fprintf(stderr, "ERROR: snapshot was taken from another simulation\n");
+    return -1;
+  }
+  if (options->num_cpus != snapshot->num_cpus) {
+    fprintf(stderr, "ERROR: snapshot has %u cpus, not %u\n", snapshot->num_cpus, options->num_cpus);
+    return -1;
+  }
+  if (0 != check_costs(sim, options))
+    return -1;
+  if (NULL != sim->policy) {
+    end_run(sim, FALSE);
+    metrics_cleanup(&sim->metrics);
+  }
+  if (0 != output_open(&sim->output, out, options->quiet, options->event_log, options->num_cpus > 1))
+    return -1;
+
+  sim->policy = snapshot->policy;
+  sim->sched_data = snapshot->policy->sched_clone(snapshot->sched_data);
+  sim->metrics_file = options->metrics_file;
+  set_costs(sim, options);
+  sim->work_stealing = options->work_stealing;
+  sim->seed = options->seed;
+
+  memcpy(sim->process_list, snapshot->procs, sim->total_procs * sizeof(struct process));
+  sim->num_procs = snapshot->num_procs;
+  sim->num_ready = snapshot->num_ready;
+  sim->current_time = snapshot->current_time;
+  sim->events_handled = snapshot->events_handled;
+  sim->initial_time_slice = snapshot->initial_time_slice;
+  sim->time_slice = snapshot->time_slice;
+
+  sim->num_cpus = snapshot->num_cpus;
+  sim->cpus = malloc(sim->num_cpus * sizeof(struct cpu));
+  assert(NULL != sim->cpus);
+  memcpy(sim->cpus, snapshot->cpus, sim->num_cpus * sizeof(struct cpu));
+
+  // the copied processes still point at the old events; point them at the new ones
+  struct evt** restored = malloc((snapshot->num_events + 1) * sizeof(struct evt*));
+  assert(NULL != restored);
+  restore_event_queue(&sim->events, snapshot->events, snapshot->num_events, snapshot->next_seq, restored);
+  for (unsigned int pid = 0; pid < sim->total_procs; ++pid) {
+    sim->process_list[pid].cpu_event = NULL;
+  }
+  for (size_t i = 0; i < snapshot->num_events; ++i) {
+    if (snapshot->is_cpu_event[i])
+      restored[i]->proc->cpu_event = restored[i];
+  }
+  sim->timer_event = (snapshot->timer_index < snapshot->num_events) ? restored[snapshot->timer_index] : NULL;
+  free(restored);
+
+  metrics_copy(&sim->metrics, &snapshot->metrics);
+  return 0;
 }
 
+
+void sim_free_snapshot(struct sim_snapshot* snapshot) {
+  if (NULL == snapshot)
+    return;
+  snapshot->policy->sched_free(snapshot->sched_data);
+  free(snapshot->procs);
+  free(snapshot->cpus);
+  free(snapshot->events);
+  free(snapshot->is_cpu_event);
+  metrics_cleanup(&snapshot->metrics);
+  free(snapshot);
+}
+
+
+int sim_finish(sim_t* sim) {
+  // INVARIANT: all processes are TERMINATED state AND event loop is empty
+  output_printf(&sim->output, "Finished at time %d\n", sim->current_time);
+  if (sim->costs.migration > 0 || sim->costs.per_switch > 0 || sim->costs.decision > 0)
+    output_printf(&sim->output, "Switching overhead: %lu ticks (%lu switching in %lu context switches, %lu deciding, %lu migrating)\n",
+                  sim->metrics.switch_time + sim->metrics.decision_time + sim->metrics.migration_time,
+                  sim->metrics.switch_time, sim->metrics.context_switches, sim->metrics.decision_time,
+                  sim->metrics.migration_time);
+#ifdef SIM_STATS
+  const char* policy_name = sim->policy->name;
+#endif
+  end_run(sim, TRUE);
+  SIM_STAT(print_sim_stats(stderr, policy_name, &sim->stats, &sim->events.stats));
+
+  int result = 0;
+  if (NULL != sim->metrics_file && 0 != metrics_write(&sim->metrics, sim->metrics_file, sim->current_time))
+    result = -1;
+  metrics_cleanup(&sim->metrics);
+  sim->metrics_file = NULL;
+  return result;
+}
+
+
+int sim_run(sim_t* sim, const struct sched_policy* policy, const struct sim_options* options, FILE* out) {
+  if (0 != sim_start(sim, policy, options, out))
+    return -1;
+  while (sim_step(sim))
+    ;
+  return sim_finish(sim);
+}
+
+
+void sim_destroy(sim_t* sim) {
+  if (NULL == sim)
+    return;
+  if (NULL != sim->policy) {
+    // abandoned mid-run: no summary, no metrics file
+    end_run(sim, FALSE);
+    metrics_cleanup(&sim->metrics);
+  }
+  release_trace(&sim->trace);
+  free(sim);
+}
@@ -0,0 +1,156 @@
+#ifndef _SIMULATION_H_
+#define _SIMULATION_H_
+
+#include "scheduler.h"
+#include <stdio.h>
+
+/* The simulator as a library.  A sim_t (see scheduler.h) owns one loaded
+ * trace and at most one run of a policy over it.  Nothing is shared between
+ * handles, so any number may exist at once, on one thread or several.
+ *
+ *   sim_t* sim = sim_create();
+ *   if (0 == sim_load(sim, "trace.proc", FALSE))
+ *     sim_run(sim, policy, &options, stdout);
+ *   sim_destroy(sim);
+ */
+
+struct sim_options {
+  unsigned int num_cpus;
+  time_ticks_t migration_cost;
+  bool_t work_stealing;
+  bool_t quiet;
+  const char* event_log;    // or NULL
+  const char* metrics_file; // or NULL
+  unsigned long seed;       // for policies that make random choices
+  time_ticks_t switch_cost;   // ticks charged for every context switch
+  time_ticks_t decision_cost; // ticks charged per scheduler hook call, plus as many per process waiting in its queue
+};
+
+/* The most one context switch and scheduling decision may charge, all three
+ * costs together, so that bursts and the clock stay far from wrapping */
+#define SIM_MAX_SWITCH_CHARGE (1u << 28)
+
+/* sim_create
+ *   returns a new simulation with no trace loaded
+ */
+sim_t* sim_create();
+
+/* sim_load
+ *   loads the trace in filename into sim, replacing any trace loaded before.
+ *   Not allowed while a run is in progress.
+ *
+ * returns 0 on success or -1 on failure, after printing what went wrong
+ */
+int sim_load(sim_t* sim, const char* filename, bool_t report_stats);
+
+/* sim_num_procs
+ *   returns the number of processes in the loaded trace
+ */
+unsigned int sim_num_procs(const sim_t* sim);
+
+/* sim_start
+ *   begins simulating the loaded trace under policy from time 0, writing the
+ *   trace output to out.  A loaded trace may be run any number of times, one
+ *   run after another.
+ *
+ * returns 0 on success, or -1 if the switching costs in options could add
+ * up to more than a time_ticks_t can safely hold or the event log could not
+ * be opened, after printing what went wrong
+ */
+int sim_start(sim_t* sim, const struct sched_policy* policy, const struct sim_options* options, FILE* out);
+
+/* sim_step
+ *   handles the next event of the run in progress
+ *
+ * returns TRUE if an event was handled, or FALSE once every process has
+ * terminated and the run is ready for sim_finish()
+ */
+bool_t sim_step(sim_t* sim);
+
+/* sim_time
+ *   returns the time of the event sim_step() handled last
+ */
+time_ticks_t sim_time(const sim_t* sim);
+
+/* sim_finish
+ *   ends the run in progress: prints the final time, cleans up the policy and
+ *   writes the metrics file, if one was asked for
+ *
+ * returns 0 on success or -1 if the metrics file could not be written
+ */
+int sim_finish(sim_t* sim);
+
+/* sim_run
+ *   sim_start(), sim_step() until the run is over, then sim_finish()
+ */
+int sim_run(sim_t* sim, const struct sched_policy* policy, const struct sim_options* options, FILE* out);
+
+/* sim_step_until
+ *   handles events of the run in progress until the next one is later than
+ *   until, or until max_events have been handled (SIM_FOREVER and ULONG_MAX
+ *   leave that limit off)
+ *
+ * returns TRUE if the run has events left, or FALSE once it is ready for
+ * sim_finish()
+ */
+#define SIM_FOREVER ((time_ticks_t)-1)
+bool_t sim_step_until(sim_t* sim, time_ticks_t until, unsigned long max_events);
+
+/* sim_events
+ *   returns the number of events handled since the run started
+ */
+unsigned long sim_events(const sim_t* sim);
+
+/* sim_set_time_slice
+ *   changes the time slice the policy gets from use_time_slice() from now on
+ *   (time slices already running keep their length)
+ */
+void sim_set_time_slice(sim_t* sim, time_ticks_t time_slice);
+
+/* Snapshots let many runs share a prefix: run to a branch point, take a
+ * snapshot, then restore it once per branch and run each one on.
+ *
+ *   sim_start(sim, policy, &options, prefix_out);
+ *   sim_step_until(sim, 1000, ULONG_MAX);
+ *   struct sim_snapshot* snapshot = sim_snapshot(sim);
+ *   for (...) {
+ *     sim_restore(sim, snapshot, &branch_options, branch_out);
+ *     while (sim_step(sim))
+ *       ;
+ *     sim_finish(sim);
+ *   }
+ *   sim_free_snapshot(snapshot);
+ */
+struct sim_snapshot;
+
+/* sim_snapshot
+ *   copies the state of the run in progress: the event heap, every process'
+ *   burst cursor, the cpus, the metrics and, through sched_clone(), the
+ *   policy's state.  The trace itself is shared, not copied.
+ *
+ * returns the snapshot, or NULL if the policy has no sched_clone()
+ */
+struct sim_snapshot* sim_snapshot(const sim_t* sim);
+
+/* sim_restore
+ *   abandons any run in progress on sim and continues the run snapshot was
+ *   taken from, writing its output to out from the snapshot's time on.
+ *   snapshot must come from sim, and options must give the same number of
+ *   cpus; the switching costs, work stealing and output options may differ.
+ *   A snapshot may be restored any number of times.
+ *
+ * returns 0 on success or -1 after printing what went wrong
+ */
+int sim_restore(sim_t* sim, const struct sim_snapshot* snapshot, const struct sim_options* options, FILE* out);
+
+/* sim_free_snapshot
+ *   frees a snapshot from sim_snapshot()
+ */
+void sim_free_snapshot(struct sim_snapshot* snapshot);
+
+/* sim_destroy
+ *   abandons any run in progress and frees sim and its trace
+ */
+void sim_destroy(sim_t* sim);
+
+#endif /* _SIMULATION_H_ */
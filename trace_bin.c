@@ -0,0 +1,145 @@
+
+#include "trace_bin.h"
+#include <endian.h>
+#include <string.h>
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TRACE_BIN_ZERO_COPY 1
+#else
+#define TRACE_BIN_ZERO_COPY 0
+#endif
+
+_Static_assert(sizeof(time_ticks_t) == sizeof(uint32_t), "bursts are stored as uint32_t");
+_Static_assert(sizeof(struct trace_bin_header) % sizeof(uint32_t) == 0, "header must keep bursts aligned");
+
+
+// reads a little-endian field from a possibly unaligned location
+static uint32_t read_le32(const void* src) {
+  uint32_t value;
+  memcpy(&value, src, sizeof(value));
+  return le32toh(value);
+}
+
+static uint64_t read_le64(const void* src) {
+  uint64_t value;
+  memcpy(&value, src, sizeof(value));
+  return le64toh(value);
+}
+
+
+int is_trace_bin(const char* data, size_t size) {
+  return size >= TRACE_BIN_MAGIC_LEN && 0 == memcmp(data, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN);
+}
+
+
+int parse_trace_bin(const char* data, size_t size, struct trace* trace) {
+  if (size < sizeof(struct trace_bin_header) || !is_trace_bin(data, size)) {
+    fprintf(stderr, "ERROR in file contents\nTruncated binary trace header\n");
+    return -1;
+  }
+  const struct trace_bin_header* header = (const struct trace_bin_header*)data;
+  uint32_t version = read_le32(&header->version);
+  if (TRACE_BIN_VERSION != version) {
+    fprintf(stderr, "ERROR in file contents\nUnsupported binary trace version %u (expected %u)\n",
+            version, TRACE_BIN_VERSION);
+    return -1;
+  }
+  trace->time_slice = read_le32(&header->time_slice);
+  trace->num_procs = read_le32(&header->num_procs);
+  uint64_t num_bursts = read_le64(&header->num_bursts);
+
+  size_t procs_offset = sizeof(struct trace_bin_header);
+  size_t bursts_offset = procs_offset + (size_t)trace->num_procs * sizeof(struct trace_bin_proc);
+  if (bursts_offset > size || num_bursts > (size - bursts_offset) / sizeof(uint32_t)) {
+    fprintf(stderr, "ERROR in file contents\nBinary trace is truncated: %u processes and %lu bursts need more than %zu bytes\n",
+            trace->num_procs, (unsigned long)num_bursts, size);
+    return -1;
+  }
+  const struct trace_bin_proc* records = (const struct trace_bin_proc*)(data + procs_offset);
+  const uint32_t* bursts = (const uint32_t*)(data + bursts_offset);
+
+  trace->procs = arena_alloc(&trace->arena, trace->num_procs * sizeof(struct process));
+  memset(trace->procs, 0, trace->num_procs * sizeof(struct process));
+
+  uint64_t next_burst = 0;
+  for (unsigned int pid = 0; pid < trace->num_procs; ++pid) {
+    struct process* proc = &trace->procs[pid];
+    proc->pid = pid;
+    proc->state = NOT_ARRIVED;
+    proc->tickets = read_le32(&records[pid].tickets);
+    proc->arrival_time = read_le32(&records[pid].arrival_time);
+    proc->num_bursts = read_le32(&records[pid].num_bursts);
+    if (proc->num_bursts > num_bursts - next_burst) {
+      fprintf(stderr, "ERROR in file contents\nProcess %u claims more bursts than the binary trace holds\n", pid);
+      return -1;
+    }
+
+#if TRACE_BIN_ZERO_COPY
+    proc->bursts = &bursts[next_burst]; // used in place from the mapping
+#else
+    time_ticks_t* copy = arena_alloc(&trace->arena, proc->num_bursts * sizeof(time_ticks_t));
+    for (unsigned int i = 0; i < proc->num_bursts; ++i) {
+      copy[i] = read_le32(&bursts[next_burst + i]);
+    }
+    proc->bursts = copy;
+#endif
+    next_burst += proc->num_bursts;
+    proc->burst_index = 0;
+    proc->remaining_time = (proc->num_bursts > 0) ? proc->bursts[0] : 0;
+  }
+  trace->num_bursts = next_burst;
+  return 0;
+}
+
+
+int write_trace_bin_header(FILE* out, time_ticks_t time_slice, uint32_t num_procs, uint64_t num_bursts) {
+  struct trace_bin_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_BIN_MAGIC, TRACE_BIN_MAGIC_LEN);
+  header.version = htole32(TRACE_BIN_VERSION);
+  header.time_slice = htole32(time_slice);
+  header.num_procs = htole32(num_procs);
+  header.num_bursts = htole64(num_bursts);
+  return (1 == fwrite(&header, sizeof(header), 1, out)) ? 0 : -1;
+}
+
+
+int write_trace_bin_proc(FILE* out, unsigned int tickets, time_ticks_t arrival_time, uint32_t num_bursts) {
+  struct trace_bin_proc record;
+  memset(&record, 0, sizeof(record));
+  record.tickets = htole32(tickets);
+  record.arrival_time = htole32(arrival_time);
+  record.num_bursts = htole32(num_bursts);
+  return (1 == fwrite(&record, sizeof(record), 1, out)) ? 0 : -1;
+}
+
+
+int write_trace_bin_bursts(FILE* out, const time_ticks_t* bursts, size_t num_bursts) {
+#if TRACE_BIN_ZERO_COPY
+  return (num_bursts == fwrite(bursts, sizeof(time_ticks_t), num_bursts, out)) ? 0 : -1;
+#else
+  for (size_t i = 0; i < num_bursts; ++i) {
+    uint32_t value = htole32(bursts[i]);
+    if (1 != fwrite(&value, sizeof(value), 1, out))
+      return -1;
+  }
+  return 0;
+#endif
+}
+
+
+int write_trace_bin(FILE* out, const struct trace* trace) {
+  if (write_trace_bin_header(out, trace->time_slice, trace->num_procs, trace->num_bursts))
+    return -1;
+  for (unsigned int pid = 0; pid < trace->num_procs; ++pid) {
+    const struct process* proc = &trace->procs[pid];
+    if (write_trace_bin_proc(out, proc->tickets, proc->arrival_time, proc->num_bursts))
+      return -1;
+  }
+  for (unsigned int pid = 0; pid < trace->num_procs; ++pid) {
+    const struct process* proc = &trace->procs[pid];
+    if (write_trace_bin_bursts(out, proc->bursts, proc->num_bursts))
+      return -1;
+  }
+  return 0;
+}
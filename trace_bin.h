@@ -0,0 +1,66 @@
+#ifndef _TRACE_BIN_H_
+#define _TRACE_BIN_H_
+
+#include "loader.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* Binary trace format (all integers little-endian):
+ *
+ *   struct trace_bin_header
+ *   struct trace_bin_proc   procs[num_procs]
+ *   uint32_t                bursts[num_bursts]  (each process' bursts in pid order)
+ *
+ * Every field is 4-byte aligned, so on a little-endian host the burst arrays
+ * are used straight out of the mapped file without copying.  Bump
+ * TRACE_BIN_VERSION whenever the layout changes.
+ */
+#define TRACE_BIN_MAGIC "SCHEDBIN"
+#define TRACE_BIN_MAGIC_LEN 8
+#define TRACE_BIN_VERSION 1
+
+struct trace_bin_header {
+  char magic[TRACE_BIN_MAGIC_LEN];
+  uint32_t version;
+  uint32_t time_slice;
+  uint32_t num_procs;
+  uint32_t reserved;
+  uint64_t num_bursts; // total over all processes
+};
+
+struct trace_bin_proc {
+  uint32_t tickets;
+  uint32_t arrival_time;
+  uint32_t num_bursts;
+  uint32_t reserved;
+};
+
+/* is_trace_bin
+ *   returns nonzero if data starts with the binary trace magic
+ */
+int is_trace_bin(const char* data, size_t size);
+
+/* parse_trace_bin
+ *   builds trace from a mapped binary trace; trace->bursts point into data,
+ *   so data must stay mapped until release_trace()
+ *
+ * returns 0 on success or -1 on failure, after printing what went wrong
+ */
+int parse_trace_bin(const char* data, size_t size, struct trace* trace);
+
+/* write_trace_bin_header / write_trace_bin_proc / write_trace_bin_bursts
+ *   stream a binary trace piece by piece: the header, then one proc record
+ *   per process, then every process' bursts in pid order
+ *
+ * each returns 0 on success or -1 on a write error
+ */
+int write_trace_bin_header(FILE* out, time_ticks_t time_slice, uint32_t num_procs, uint64_t num_bursts);
+int write_trace_bin_proc(FILE* out, unsigned int tickets, time_ticks_t arrival_time, uint32_t num_bursts);
+int write_trace_bin_bursts(FILE* out, const time_ticks_t* bursts, size_t num_bursts);
+
+/* write_trace_bin
+ *   writes an entire loaded trace in binary form
+ */
+int write_trace_bin(FILE* out, const struct trace* trace);
+
+#endif /* _TRACE_BIN_H_ */